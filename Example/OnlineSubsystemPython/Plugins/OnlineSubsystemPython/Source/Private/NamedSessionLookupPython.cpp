@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "NamedSessionLookupPython.h"
+#include "NamedSessionPoolPython.h"
+
+FNamedSessionLookupPython::FNamedSessionLookupPython() :
+	Sequence(0),
+	bOverflowed(false),
+	bAnyPresenceSession(false)
+{
+	for (int32 Slot = 0; Slot < NumSlots; Slot++)
+	{
+		SlotKeys[Slot].store(0, std::memory_order_relaxed);
+		SlotSessions[Slot].store(nullptr, std::memory_order_relaxed);
+		SlotStates[Slot].store((uint8)EOnlineSessionState::NoSession, std::memory_order_relaxed);
+	}
+}
+
+uint64 FNamedSessionLookupPython::GetKey(FName SessionName)
+{
+	// Same identity FName's operator== compares
+	return ((uint64)SessionName.GetComparisonIndex().ToUnstableInt() << 32) | (uint32)SessionName.GetNumber();
+}
+
+void FNamedSessionLookupPython::Publish(const FNamedSessionPoolPython& Sessions)
+{
+	const uint32 StartSequence = Sequence.load(std::memory_order_relaxed);
+	Sequence.store(StartSequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (int32 Slot = 0; Slot < NumSlots; Slot++)
+	{
+		SlotKeys[Slot].store(0, std::memory_order_relaxed);
+		SlotSessions[Slot].store(nullptr, std::memory_order_relaxed);
+	}
+
+	bool bAnyPresence = false;
+	const bool bFull = Sessions.Num() > MaxSessions;
+	for (int32 SessionIndex = 0; SessionIndex < Sessions.Num(); SessionIndex++)
+	{
+		FNamedOnlineSession& Session = Sessions[SessionIndex];
+		bAnyPresence |= Session.SessionSettings.bUsesPresence;
+
+		const uint64 Key = GetKey(Session.SessionName);
+		if (bFull || Key == 0)
+		{
+			continue;
+		}
+
+		uint32 Slot = GetTypeHash(Session.SessionName) & (NumSlots - 1);
+		while (SlotKeys[Slot].load(std::memory_order_relaxed) != 0)
+		{
+			Slot = (Slot + 1) & (NumSlots - 1);
+		}
+		SlotKeys[Slot].store(Key, std::memory_order_relaxed);
+		SlotSessions[Slot].store(&Session, std::memory_order_relaxed);
+		SlotStates[Slot].store((uint8)Session.SessionState, std::memory_order_relaxed);
+	}
+	bOverflowed.store(bFull, std::memory_order_relaxed);
+	bAnyPresenceSession.store(bAnyPresence, std::memory_order_relaxed);
+
+	Sequence.store(StartSequence + 2, std::memory_order_release);
+}
+
+bool FNamedSessionLookupPython::Find(FName SessionName, FNamedOnlineSession*& OutSession, EOnlineSessionState::Type& OutState) const
+{
+	const uint64 Key = GetKey(SessionName);
+	if (Key == 0)
+	{
+		return false;
+	}
+
+	for (int32 Attempt = 0; Attempt < MaxReadAttempts; Attempt++)
+	{
+		const uint32 StartSequence = Sequence.load(std::memory_order_acquire);
+		if (StartSequence & 1)
+		{
+			continue;
+		}
+
+		const bool bWasOverflowed = bOverflowed.load(std::memory_order_relaxed);
+		FNamedOnlineSession* FoundSession = nullptr;
+		uint8 FoundState = (uint8)EOnlineSessionState::NoSession;
+		uint32 Slot = GetTypeHash(SessionName) & (NumSlots - 1);
+		for (int32 Probe = 0; Probe < NumSlots; Probe++)
+		{
+			const uint64 SlotKey = SlotKeys[Slot].load(std::memory_order_relaxed);
+			if (SlotKey == Key)
+			{
+				FoundSession = SlotSessions[Slot].load(std::memory_order_relaxed);
+				FoundState = SlotStates[Slot].load(std::memory_order_relaxed);
+				break;
+			}
+			if (SlotKey == 0)
+			{
+				break;
+			}
+			Slot = (Slot + 1) & (NumSlots - 1);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (Sequence.load(std::memory_order_relaxed) == StartSequence)
+		{
+			if (bWasOverflowed)
+			{
+				return false;
+			}
+			OutSession = FoundSession;
+			OutState = (EOnlineSessionState::Type)FoundState;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FNamedSessionLookupPython::HasPresenceSession() const
+{
+	// A single flag is consistent on its own, it doesn't need the sequence check
+	return bAnyPresenceSession.load(std::memory_order_acquire);
+}
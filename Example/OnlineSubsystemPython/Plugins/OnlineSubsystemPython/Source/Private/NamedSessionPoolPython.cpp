@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "NamedSessionPoolPython.h"
+
+FNamedSessionPoolPython::~FNamedSessionPoolPython()
+{
+	Empty();
+}
+
+int32 FNamedSessionPoolPython::AllocateSlot()
+{
+	if (FreeIndices.Num() == 0)
+	{
+		// Push in reverse so slots are handed out in address order
+		const int32 FirstIndex = Slabs.Num() * SessionsPerSlab;
+		Slabs.Add(MakeUnique<FSlab>());
+		for (int32 Index = FirstIndex + SessionsPerSlab - 1; Index >= FirstIndex; Index--)
+		{
+			FreeIndices.Add(Index);
+		}
+	}
+	return FreeIndices.Pop(false);
+}
+
+void FNamedSessionPoolPython::RemoveAt(int32 LiveIndex)
+{
+	const int32 Index = LiveIndices[LiveIndex];
+	FSlot& Slot = GetSlot(Index);
+	check(Slot.bLive);
+
+	Slot.Storage.GetTypedPtr()->~FNamedOnlineSession();
+	Slot.bLive = false;
+	Slot.Generation++;
+
+	LiveIndices.RemoveAtSwap(LiveIndex, 1, false);
+	FreeIndices.Add(Index);
+}
+
+void FNamedSessionPoolPython::Empty()
+{
+	while (LiveIndices.Num() > 0)
+	{
+		RemoveAt(LiveIndices.Num() - 1);
+	}
+}
+
+FNamedSessionHandlePython FNamedSessionPoolPython::GetHandle(const FNamedOnlineSession* Session) const
+{
+	FNamedSessionHandlePython Handle;
+	for (int32 Index : LiveIndices)
+	{
+		const FSlot& Slot = GetSlot(Index);
+		if (Slot.Storage.GetTypedPtr() == Session)
+		{
+			Handle.Index = Index;
+			Handle.Generation = Slot.Generation;
+			break;
+		}
+	}
+	return Handle;
+}
+
+FNamedOnlineSession* FNamedSessionPoolPython::Resolve(const FNamedSessionHandlePython& Handle) const
+{
+	if (Handle.Index < 0 || Handle.Index >= Slabs.Num() * SessionsPerSlab)
+	{
+		return nullptr;
+	}
+
+	FSlot& Slot = GetSlot(Handle.Index);
+	if (!Slot.bLive || Slot.Generation != Handle.Generation)
+	{
+		return nullptr;
+	}
+	return Slot.Storage.GetTypedPtr();
+}
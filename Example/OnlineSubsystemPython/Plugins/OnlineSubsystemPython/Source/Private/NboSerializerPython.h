@@ -16,8 +16,56 @@ Permission is granted to anyone to use this software for any purpose, including
 
 #include "CoreMinimal.h"
 #include "OnlineSubsystemPythonTypes.h"
+#include "OnlineSessionSettings.h"
 #include "NboSerializer.h"
 
+/** Marks a LAN response packing one or more session records. Legacy responses start with the owner id length instead, which is never this large */
+#define LAN_PACKED_RESPONSE_MAGIC 0x50594C50
+/** Version of the packed response layout */
+#define LAN_PACKED_RESPONSE_VERSION 1
+/** Set in the packed response flags when the host sends further packets for the same query */
+#define LAN_PACKED_RESPONSE_MORE_FOLLOWS 0x01
+/** Size of the magic, version, flags and record count that start a packed response */
+#define LAN_PACKED_RESPONSE_HEADER_SIZE 8
+/** Size of the length prefix before each record of a packed response */
+#define LAN_PACKED_RECORD_HEADER_SIZE 2
+
+/** Version byte that starts the compact session settings of a packed response record */
+#define LAN_COMPACT_SETTINGS_VERSION 1
+/** Longest varint that can hold a 64 bit value */
+#define LAN_MAX_VARINT_SIZE 10
+
+/**
+ * Smallest session record ahead of the host address: the owner id, owner name and session id length prefixes and the two connection counts.
+ * The address itself isn't counted as its size depends on the address family.
+ */
+#define LAN_MIN_SESSION_HEADER_SIZE 20
+/** Smallest compact settings block: version, both connection counts, flags, build id and the setting count */
+#define LAN_MIN_COMPACT_SETTINGS_SIZE 7
+/** Smallest fixed width settings block: both connection counts, the ten flag bytes, build id and the setting count */
+#define LAN_MIN_LEGACY_SETTINGS_SIZE 26
+
+/**
+ * Setting keys sent as a small id instead of a full name in compact session settings.
+ * The index is part of the wire format, so only ever append to this list.
+ */
+inline const TArray<FName>& GetLANSettingsKeyDictionary()
+{
+	static const TArray<FName> Keys =
+	{
+		SETTING_MAPNAME,
+		SETTING_GAMEMODE,
+		SETTING_NUMBOTS,
+		SETTING_BEACONPORT,
+		SEARCH_KEYWORDS,
+		FName(TEXT("SERVERNAME")),
+		FName(TEXT("PASSWORDPROTECTED")),
+		FName(TEXT("PLAYERCOUNT")),
+		FName(TEXT("MAXPLAYERS"))
+	};
+	return Keys;
+}
+
 /**
  * Serializes data in network byte order form into a buffer
  */
@@ -53,9 +101,134 @@ public:
 	 */
 	friend inline FNboSerializeToBufferNull& operator<<(FNboSerializeToBufferNull& Ar, const FUniqueNetIdPython& UniqueId)
 	{
-		Ar << UniqueId.UniqueNetIdStr;
+		Ar << UniqueId.ToString();
 		return Ar;
 	}
+
+	/**
+	 * Adds a 16 bit value to the buffer in network byte order
+	 * (named rather than an operator so it can't be picked over the base class integer overloads)
+	 */
+	inline void WriteUInt16(uint16 Value)
+	{
+		*this << (uint8)(Value >> 8) << (uint8)(Value & 0xFF);
+	}
+
+	/**
+	 * Adds an unsigned integer using 7 bits per byte, low bits first, with the high bit set on every byte but the last
+	 */
+	inline void WriteVarUInt(uint64 Value)
+	{
+		while (Value >= 0x80)
+		{
+			*this << (uint8)((Value & 0x7F) | 0x80);
+			Value >>= 7;
+		}
+		*this << (uint8)Value;
+	}
+
+	/**
+	 * Adds a signed integer as a zigzag varint, so small negative values stay small
+	 */
+	inline void WriteVarInt(int64 Value)
+	{
+		WriteVarUInt(((uint64)Value << 1) ^ (uint64)(Value >> 63));
+	}
+
+	/**
+	 * Adds a string as a varint byte count followed by its UTF-8 bytes
+	 */
+	inline void WriteCompactString(const FString& Value)
+	{
+		FTCHARToUTF8 Converted(*Value);
+		WriteVarUInt(Converted.Length());
+		WriteBinary((const uint8*)Converted.Get(), Converted.Length());
+	}
+
+	/**
+	 * Adds a session setting as one byte holding the data type and advertisement type, followed by the value.
+	 * Integers are varints and strings are UTF-8. Json values are sent as their string.
+	 */
+	inline void WriteCompactSetting(const FOnlineSessionSetting& Setting)
+	{
+		const FVariantData& Data = Setting.Data;
+		const EOnlineKeyValuePairDataType::Type WireType = Data.GetType() == EOnlineKeyValuePairDataType::Json ? EOnlineKeyValuePairDataType::String : Data.GetType();
+		*this << (uint8)(((uint8)WireType << 2) | ((uint8)Setting.AdvertisementType & 0x3));
+		switch (Data.GetType())
+		{
+			case EOnlineKeyValuePairDataType::Int32:
+			{
+				int32 Value = 0;
+				Data.GetValue(Value);
+				WriteVarInt(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::UInt32:
+			{
+				uint32 Value = 0;
+				Data.GetValue(Value);
+				WriteVarUInt(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Int64:
+			{
+				int64 Value = 0;
+				Data.GetValue(Value);
+				WriteVarInt(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::UInt64:
+			{
+				uint64 Value = 0;
+				Data.GetValue(Value);
+				WriteVarUInt(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Bool:
+			{
+				bool bValue = false;
+				Data.GetValue(bValue);
+				*this << (uint8)bValue;
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Float:
+			{
+				float Value = 0.0f;
+				Data.GetValue(Value);
+				*this << Value;
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Double:
+			{
+				double Value = 0.0;
+				Data.GetValue(Value);
+				*this << Value;
+				break;
+			}
+			case EOnlineKeyValuePairDataType::String:
+			{
+				FString Value;
+				Data.GetValue(Value);
+				WriteCompactString(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Json:
+			{
+				WriteCompactString(Data.ToString());
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Blob:
+			{
+				TArray<uint8> Value;
+				Data.GetValue(Value);
+				WriteVarUInt(Value.Num());
+				WriteBinary(Value.GetData(), Value.Num());
+				break;
+			}
+			default:
+				break;
+		}
+	}
 };
 
 /**
@@ -89,7 +262,210 @@ public:
 	 */
 	friend inline FNboSerializeFromBufferNull& operator>>(FNboSerializeFromBufferNull& Ar, FUniqueNetIdPython& UniqueId)
 	{
-		Ar >> UniqueId.UniqueNetIdStr;
+		FString UniqueIdStr;
+		Ar >> UniqueIdStr;
+		UniqueId = FUniqueNetIdPython(UniqueIdStr);
 		return Ar;
 	}
+
+	/**
+	 * Reads a 16 bit value in network byte order from the buffer
+	 */
+	inline void ReadUInt16(uint16& OutValue)
+	{
+		uint8 High = 0;
+		uint8 Low = 0;
+		*this >> High >> Low;
+		OutValue = (uint16)((High << 8) | Low);
+	}
+
+	/** @return the number of bytes that haven't been read yet */
+	inline int32 GetBytesRemaining() const
+	{
+		return bHasOverflowed ? 0 : NumBytes - CurrentOffset;
+	}
+
+	/**
+	 * Skips over a block of the buffer so it can be decoded in place
+	 *
+	 * @param NumToSkip the number of bytes to skip
+	 *
+	 * @return the start of the skipped block, or null (and the buffer is flagged as overflowed) if there weren't enough bytes left
+	 */
+	inline const uint8* SkipBytes(int32 NumToSkip)
+	{
+		if (NumToSkip < 0 || NumToSkip > GetBytesRemaining())
+		{
+			bHasOverflowed = true;
+			return nullptr;
+		}
+		const uint8* Block = Data + CurrentOffset;
+		CurrentOffset += NumToSkip;
+		return Block;
+	}
+
+	/**
+	 * Flags the buffer as overflowed, for data that decoded but failed validation
+	 */
+	inline void MarkMalformed()
+	{
+		bHasOverflowed = true;
+	}
+
+	/**
+	 * Reads a varint written by WriteVarUInt, flagging an overflow if it runs past the buffer or is longer than any 64 bit value
+	 */
+	inline void ReadVarUInt(uint64& OutValue)
+	{
+		OutValue = 0;
+		for (int32 Shift = 0; Shift < LAN_MAX_VARINT_SIZE * 7; Shift += 7)
+		{
+			uint8 Byte = 0;
+			*this >> Byte;
+			if (bHasOverflowed)
+			{
+				break;
+			}
+			OutValue |= (uint64)(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0)
+			{
+				return;
+			}
+		}
+		bHasOverflowed = true;
+		OutValue = 0;
+	}
+
+	/**
+	 * Reads a zigzag varint written by WriteVarInt
+	 */
+	inline void ReadVarInt(int64& OutValue)
+	{
+		uint64 Encoded = 0;
+		ReadVarUInt(Encoded);
+		OutValue = (int64)(Encoded >> 1) ^ -(int64)(Encoded & 1);
+	}
+
+	/**
+	 * Reads a varint that has to fit in an int32, flagging an overflow if it doesn't
+	 */
+	inline void ReadVarInt32(int32& OutValue)
+	{
+		int64 Value = 0;
+		ReadVarInt(Value);
+		if (Value < MIN_int32 || Value > MAX_int32)
+		{
+			bHasOverflowed = true;
+			Value = 0;
+		}
+		OutValue = (int32)Value;
+	}
+
+	/**
+	 * Reads a string written by WriteCompactString, the length is checked against the buffer before anything is allocated
+	 */
+	inline void ReadCompactString(FString& OutValue)
+	{
+		uint64 Length = 0;
+		ReadVarUInt(Length);
+		const uint8* Bytes = SkipBytes(Length > (uint64)MAX_int32 ? -1 : (int32)Length);
+		if (Bytes == nullptr)
+		{
+			OutValue.Empty();
+			return;
+		}
+		FUTF8ToTCHAR Converted((const ANSICHAR*)Bytes, (int32)Length);
+		OutValue = FString(Converted.Length(), Converted.Get());
+	}
+
+	/**
+	 * Reads a session setting written by WriteCompactSetting
+	 */
+	inline void ReadCompactSetting(FOnlineSessionSetting& OutSetting)
+	{
+		uint8 Types = 0;
+		*this >> Types;
+		OutSetting.AdvertisementType = (EOnlineDataAdvertisementType::Type)(Types & 0x3);
+		switch ((EOnlineKeyValuePairDataType::Type)(Types >> 2))
+		{
+			case EOnlineKeyValuePairDataType::Empty:
+			{
+				OutSetting.Data.Empty();
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Int32:
+			{
+				int32 Value = 0;
+				ReadVarInt32(Value);
+				OutSetting.Data.SetValue(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::UInt32:
+			{
+				uint64 Value = 0;
+				ReadVarUInt(Value);
+				OutSetting.Data.SetValue((uint32)Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Int64:
+			{
+				int64 Value = 0;
+				ReadVarInt(Value);
+				OutSetting.Data.SetValue(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::UInt64:
+			{
+				uint64 Value = 0;
+				ReadVarUInt(Value);
+				OutSetting.Data.SetValue(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Bool:
+			{
+				uint8 Value = 0;
+				*this >> Value;
+				OutSetting.Data.SetValue(Value != 0);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Float:
+			{
+				float Value = 0.0f;
+				*this >> Value;
+				OutSetting.Data.SetValue(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Double:
+			{
+				double Value = 0.0;
+				*this >> Value;
+				OutSetting.Data.SetValue(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::String:
+			{
+				FString Value;
+				ReadCompactString(Value);
+				OutSetting.Data.SetValue(Value);
+				break;
+			}
+			case EOnlineKeyValuePairDataType::Blob:
+			{
+				uint64 Length = 0;
+				ReadVarUInt(Length);
+				const uint8* Bytes = SkipBytes(Length > (uint64)MAX_int32 ? -1 : (int32)Length);
+				if (Bytes)
+				{
+					OutSetting.Data.SetValue((uint32)Length, Bytes);
+				}
+				break;
+			}
+			default:
+			{
+				// Unknown type, nothing after it can be trusted
+				bHasOverflowed = true;
+				break;
+			}
+		}
+	}
 };
@@ -0,0 +1,174 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "OnlineRequestStatsPython.h"
+#include "Misc/OutputDevice.h"
+
+DEFINE_STAT(STAT_PythonRequest_Build);
+DEFINE_STAT(STAT_PythonRequest_Parse);
+DEFINE_STAT(STAT_PythonRequest_Results);
+DEFINE_STAT(STAT_PythonRequest_Dispatch);
+DEFINE_STAT(STAT_PythonRequestsInFlight);
+DEFINE_STAT(STAT_PythonRequestsCompleted);
+DEFINE_STAT(STAT_PythonRequestsFailed);
+
+/** Upper bounds of the latency histogram buckets in milliseconds, the last bucket catches everything above */
+static const float HistogramBucketsMs[] = { 0.1f, 0.5f, 1.0f, 5.0f, 10.0f, 50.0f, 100.0f, 250.0f, 500.0f, 1000.0f, 5000.0f };
+
+/** @return the nearest-rank percentile of already sorted samples */
+static float GetPercentile(const TArray<float>& SortedSamples, float Fraction)
+{
+	if (SortedSamples.Num() == 0)
+	{
+		return 0.0f;
+	}
+	const int32 Rank = FMath::Clamp(FMath::CeilToInt(Fraction * SortedSamples.Num()), 1, SortedSamples.Num());
+	return SortedSamples[Rank - 1];
+}
+
+FOnlineRequestStatsPython::FOnlineRequestStatsPython()
+{
+	Reset();
+}
+
+void FOnlineRequestStatsPython::AddSample(EPythonRequest::Type RequestType, EPythonRequestPhase::Type Phase, double Seconds)
+{
+	check(RequestType < EPythonRequest::Num && Phase < EPythonRequestPhase::Num);
+
+	FScopeLock ScopeLock(&StatsLock);
+	FSampleHistory& History = Histories[RequestType][Phase];
+	if (History.Samples.Num() < MaxSamples)
+	{
+		History.Samples.Add((float)Seconds);
+	}
+	else
+	{
+		History.Samples[History.NextSample] = (float)Seconds;
+	}
+	History.NextSample = (History.NextSample + 1) % MaxSamples;
+}
+
+void FOnlineRequestStatsPython::RequestStarted(EPythonRequest::Type RequestType)
+{
+	INC_DWORD_STAT(STAT_PythonRequestsInFlight);
+
+	FScopeLock ScopeLock(&StatsLock);
+	NumStarted[RequestType]++;
+}
+
+void FOnlineRequestStatsPython::RequestCompleted(EPythonRequest::Type RequestType, bool bWasSuccessful)
+{
+	DEC_DWORD_STAT(STAT_PythonRequestsInFlight);
+	if (bWasSuccessful)
+	{
+		INC_DWORD_STAT(STAT_PythonRequestsCompleted);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_PythonRequestsFailed);
+	}
+
+	FScopeLock ScopeLock(&StatsLock);
+	NumCompleted[RequestType]++;
+	if (!bWasSuccessful)
+	{
+		NumFailed[RequestType]++;
+	}
+}
+
+void FOnlineRequestStatsPython::Dump(FOutputDevice& Ar) const
+{
+	FScopeLock ScopeLock(&StatsLock);
+
+	Ar.Logf(TEXT("Master server request stats (last %d samples per phase, times in ms)"), MaxSamples);
+	for (int32 RequestIdx = 0; RequestIdx < EPythonRequest::Num; RequestIdx++)
+	{
+		if (NumStarted[RequestIdx] == 0 && NumCompleted[RequestIdx] == 0)
+		{
+			continue;
+		}
+
+		Ar.Logf(TEXT("%s: %d sent, %d completed, %d failed"),
+			EPythonRequest::ToString((EPythonRequest::Type)RequestIdx),
+			NumStarted[RequestIdx],
+			NumCompleted[RequestIdx],
+			NumFailed[RequestIdx]);
+
+		for (int32 PhaseIdx = 0; PhaseIdx < EPythonRequestPhase::Num; PhaseIdx++)
+		{
+			const FSampleHistory& History = Histories[RequestIdx][PhaseIdx];
+			if (History.Samples.Num() == 0)
+			{
+				continue;
+			}
+
+			TArray<float> SortedMs;
+			SortedMs.Reserve(History.Samples.Num());
+			for (float Sample : History.Samples)
+			{
+				SortedMs.Add(Sample * 1000.0f);
+			}
+			SortedMs.Sort();
+
+			Ar.Logf(TEXT("  %-8s n=%-4d p50=%.3f p90=%.3f p99=%.3f max=%.3f"),
+				EPythonRequestPhase::ToString((EPythonRequestPhase::Type)PhaseIdx),
+				SortedMs.Num(),
+				GetPercentile(SortedMs, 0.50f),
+				GetPercentile(SortedMs, 0.90f),
+				GetPercentile(SortedMs, 0.99f),
+				SortedMs.Last());
+
+			// Samples are sorted, so the histogram is a single walk over the buckets
+			FString Histogram;
+			int32 SampleIdx = 0;
+			for (int32 BucketIdx = 0; BucketIdx <= UE_ARRAY_COUNT(HistogramBucketsMs); BucketIdx++)
+			{
+				const bool bIsLastBucket = BucketIdx == UE_ARRAY_COUNT(HistogramBucketsMs);
+				int32 BucketCount = 0;
+				while (SampleIdx < SortedMs.Num() && (bIsLastBucket || SortedMs[SampleIdx] <= HistogramBucketsMs[BucketIdx]))
+				{
+					BucketCount++;
+					SampleIdx++;
+				}
+				if (BucketCount > 0)
+				{
+					if (bIsLastBucket)
+					{
+						Histogram += FString::Printf(TEXT(" >%g:%d"), HistogramBucketsMs[BucketIdx - 1], BucketCount);
+					}
+					else
+					{
+						Histogram += FString::Printf(TEXT(" <=%g:%d"), HistogramBucketsMs[BucketIdx], BucketCount);
+					}
+				}
+			}
+			Ar.Logf(TEXT("           %s"), *Histogram);
+		}
+	}
+}
+
+void FOnlineRequestStatsPython::Reset()
+{
+	FScopeLock ScopeLock(&StatsLock);
+	for (int32 RequestIdx = 0; RequestIdx < EPythonRequest::Num; RequestIdx++)
+	{
+		for (int32 PhaseIdx = 0; PhaseIdx < EPythonRequestPhase::Num; PhaseIdx++)
+		{
+			Histories[RequestIdx][PhaseIdx] = FSampleHistory();
+		}
+		NumStarted[RequestIdx] = 0;
+		NumCompleted[RequestIdx] = 0;
+		NumFailed[RequestIdx] = 0;
+	}
+}
@@ -24,12 +24,42 @@ Permission is granted to anyone to use this software for any purpose, including
 #include "Templates/SharedPointer.h"
 #include "Runtime/Sockets/Public/IPAddress.h"
 #include "OnlineSubsystemPythonConfig.h"
+#include "OnlineRequestStatsPython.h"
+#include "OnlineSessionAsyncMasterServerPython.h"
+#include "OnlineIdentityPython.h"
 #include "Engine/World.h"
 
+/** A LAN search finishes once no host has answered for this many smoothed response gaps */
+static const double LANSearchQuietGaps = 4.0;
+
+/** Shortest quiet window, so hosts answering a little behind a burst of fast ones still make it in */
+static const double LANSearchMinQuietSeconds = 0.3;
+
+/** A LAN search never finishes early sooner than this after the query went out */
+static const double LANSearchMinSeconds = 0.5;
+
+/** Weight of the newest gap in the smoothed time between LAN responses */
+static const double LANSearchGapSmoothing = 0.25;
+
+/** A combined LAN and internet search completes with whatever it has this long after it started */
+static const double HybridSearchDeadlineSeconds = 5.0;
+
+/** Player count changes made within this long of the first one are sent to the master server together */
+static const double PlayerCountPushDelaySeconds = 2.0;
+
+/** A due player count is left for the heartbeat if the heartbeat is due within this long */
+static const float PlayerCountHeartbeatWaitSeconds = 5.0f;
+
+/** Most friends looked up in one find_friend_sessions request, the master server ignores any more */
+static const int32 MaxFriendsPerLookup = 100;
+
+/** Most members of a group one group_join request finds room for, the master server turns larger groups away */
+static const int32 MaxGroupSize = 16;
+
 
 FOnlineSessionInfoPython::FOnlineSessionInfoPython() :
 	HostAddr(NULL),
-	SessionId(TEXT("INVALID"))
+	SessionId()
 {
 }
 
@@ -56,7 +86,7 @@ void FOnlineSessionInfoPython::Init(const FOnlineSubsystemPython& Subsystem)
 
 	FGuid OwnerGuid;
 	FPlatformMisc::CreateGuid(OwnerGuid);
-	SessionId = FUniqueNetIdPython(OwnerGuid.ToString());
+	SessionId = FUniqueNetIdPython(OwnerGuid);
 }
 
 /**
@@ -103,11 +133,11 @@ public:
 	 */
 	virtual void Finalize() override
 	{
-		IOnlineSessionPtr SessionInt = Subsystem->GetSessionInterface();
+		FOnlineSessionPythonPtr SessionInt = StaticCastSharedPtr<FOnlineSessionPython>(Subsystem->GetSessionInterface());
 		FNamedOnlineSession* Session = SessionInt->GetNamedSession(SessionName);
 		if (Session)
 		{
-			Session->SessionState = EOnlineSessionState::Ended;
+			SessionInt->SetSessionState(*Session, EOnlineSessionState::Ended);
 		}
 	}
 
@@ -204,7 +234,8 @@ bool FOnlineSessionPython::CreateSession(int32 HostingPlayerNum, FName SessionNa
 		Session = AddNamedSession(SessionName, NewSessionSettings);
 		check(Session);
 		CreateSessionName = SessionName;
-		Session->SessionState = EOnlineSessionState::Creating;
+		CreateSessionHandle = GetSessionHandle(Session);
+		SetSessionState(*Session, EOnlineSessionState::Creating);
 		Session->NumOpenPrivateConnections = NewSessionSettings.NumPrivateConnections;
 		Session->NumOpenPublicConnections = NewSessionSettings.NumPublicConnections;	// always start with full public connections, local player will register later
 
@@ -241,7 +272,7 @@ bool FOnlineSessionPython::CreateSession(int32 HostingPlayerNum, FName SessionNa
 			if (Result != ONLINE_IO_PENDING)
 			{
 				// Set the game state as pending (not started)
-				Session->SessionState = EOnlineSessionState::Pending;
+				SetSessionState(*Session, EOnlineSessionState::Pending);
 
 				if (Result != ONLINE_SUCCESS)
 				{
@@ -257,25 +288,13 @@ bool FOnlineSessionPython::CreateSession(int32 HostingPlayerNum, FName SessionNa
 		else
 		{
 			Result = ONLINE_IO_PENDING;
-			FHttpModule* Http = &FHttpModule::Get();
-			TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
-			Request->SetHeader(TEXT("User-Agent"), TEXT("X-UnrealEngine-Agent"));
-			Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-			//Request->SetHeader(TEXT("Authorization"), "Basic " + APIKey);
-			Request->SetVerb("GET");
-			FString ServerName, MapName, GameMode;
-			Session->SessionSettings.Get("SERVERNAME", ServerName);
-			Session->SessionSettings.Get("MAPNAME", MapName);
-			Session->SessionSettings.Get("GAMEMODE", GameMode);
-			bool bPasswordProtected;
-			Session->SessionSettings.Get("PASSWORDPROTECTED", bPasswordProtected);
-			FString StrPasswordProtected = bPasswordProtected ? "true" : "false";
-			FOnlineSessionInfoPython* SessionInfo = (FOnlineSessionInfoPython*)Session->SessionInfo.Get();
-			UOnlineSubsystemPythonConfig* config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
-			SetPortFromNetDriver(*PythonSubsystem, Session->SessionInfo);
-			Request->SetURL(FString::Printf(TEXT("http://%s/register_server?name=%s&port=%d&maxplayers=%d&pwprotected=%s&gamemode=%s&map=%s"), *config->ServerAddress, *FGenericPlatformHttp::UrlEncode(ServerName), SessionInfo->HostAddr->GetPort(), Session->NumOpenPublicConnections, *FGenericPlatformHttp::UrlEncode(StrPasswordProtected), *FGenericPlatformHttp::UrlEncode(GameMode), *FGenericPlatformHttp::UrlEncode(MapName)));
-			Request->OnProcessRequestComplete().BindRaw(this, &FOnlineSessionPython::CreateSession_ResponseReceived);
-			Request->ProcessRequest();
+			// register_server needs the host's login token, which the login started at startup may not have brought back yet
+			FOnlineIdentityPythonPtr IdentityInt = StaticCastSharedPtr<FOnlineIdentityPython>(Identity);
+			bRegisterAwaitingLogin = IdentityInt.IsValid() && IdentityInt->EnsureMasterServerLogin(FOnlineIdentityPython::MasterServerUserNum);
+			if (!bRegisterAwaitingLogin)
+			{
+				QueueRegisterServer(*Session);
+			}
 		}
 	}
 	else
@@ -291,48 +310,44 @@ bool FOnlineSessionPython::CreateSession(int32 HostingPlayerNum, FName SessionNa
 	return Result == ONLINE_IO_PENDING || Result == ONLINE_SUCCESS;
 }
 
-bool FOnlineSessionPython::CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
+void FOnlineSessionPython::QueueRegisterServer(FNamedOnlineSession& Session, bool bReregister)
 {
-	// todo: use proper	HostingPlayerId
-	return CreateSession(0, SessionName, NewSessionSettings);
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::RegisterServer, Build);
+	// register_server takes the same settings as update_server, with the full size of the session as its maximum
+	SetPortFromNetDriver(*PythonSubsystem, Session.SessionInfo);
+	FString Query = MakeUpdateServerQuery(Session);
+	QueueMasterServerRequest(new FOnlineAsyncTaskPythonRegisterServer(PythonSubsystem, Session.SessionName, CreateSessionHandle, Query, bReregister));
 }
 
-void FOnlineSessionPython::CreateSession_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
+void FOnlineSessionPython::TickRegisterAwaitingLogin()
 {
-	if (!Response.IsValid())
+	if (!bRegisterAwaitingLogin)
 	{
+		return;
+	}
 
-		TriggerOnCreateSessionCompleteDelegates(CreateSessionName, false);
-		UE_LOG_ONLINE_SESSION(Error, TEXT("Error Creating Python Session! No Response from Master Server"));
-		DestroySession(CreateSessionName);
+	FOnlineIdentityPythonPtr IdentityInt = StaticCastSharedPtr<FOnlineIdentityPython>(PythonSubsystem->GetIdentityInterface());
+	if (IdentityInt.IsValid() && IdentityInt->IsLoggingInToMasterServer(FOnlineIdentityPython::MasterServerUserNum))
+	{
 		return;
 	}
-	TSharedPtr<FJsonObject> JsonObject;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(Reader, JsonObject))
+	bRegisterAwaitingLogin = false;
+
+	// The login may have failed, the master server then refuses the registration and CreateSession fails as it would have anyway
+	FNamedOnlineSession* Session = ResolveSessionHandle(CreateSessionHandle);
+	if (Session == nullptr)
 	{
-		//Get the value of the json object by field name
-		bool bError = JsonObject->GetBoolField("error");
-		if (!bError)
-		{
-			FNamedOnlineSession* Session = GetNamedSession(CreateSessionName);
-			if (Session)
-			{
-				Session->SessionState = EOnlineSessionState::Pending;
-			}
-			float HeartbeatDelta = JsonObject->GetNumberField("heartbeat") - 1.0f;
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Created Python Session! Heartbeat Delta: %f"), HeartbeatDelta);
-			TriggerOnCreateSessionCompleteDelegates(CreateSessionName, true);
-			StartHeartbeat(FMath::Clamp(HeartbeatDelta, 0.01f, 10000.0f));
-		}
-		else
-		{
-			FString ErrorMessage = JsonObject->GetStringField("message");
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Error Creating Python Session! %s"),  *ErrorMessage);
-			TriggerOnCreateSessionCompleteDelegates(CreateSessionName, false);
-			DestroySession(CreateSessionName);
-		}
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Python Session was destroyed before the Master Server registered it"));
+		TriggerOnCreateSessionCompleteDelegates(CreateSessionName, false);
+		return;
 	}
+	QueueRegisterServer(*Session);
+}
+
+bool FOnlineSessionPython::CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
+{
+	// todo: use proper	HostingPlayerId
+	return CreateSession(0, SessionName, NewSessionSettings);
 }
 
 bool FOnlineSessionPython::NeedsToAdvertise()
@@ -434,7 +449,7 @@ bool FOnlineSessionPython::StartSession(FName SessionName)
 		{
 			// If this lan match has join in progress disabled, shut down the beacon
 			Result = UpdateLANStatus();
-			Session->SessionState = EOnlineSessionState::InProgress;
+			SetSessionState(*Session, EOnlineSessionState::InProgress);
 		}
 		else
 		{
@@ -464,66 +479,24 @@ bool FOnlineSessionPython::UpdateSession(FName SessionName, FOnlineSessionSettin
 	FNamedOnlineSession* Session = GetNamedSession(SessionName);
 	if (Session)
 	{
-		// @TODO ONLINE update LAN settings
-		Session->SessionSettings = UpdatedSessionSettings;
-		FHttpModule* Http = &FHttpModule::Get();
-		TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
-		Request->SetHeader(TEXT("User-Agent"), TEXT("X-UnrealEngine-Agent"));
-		Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-		//Request->SetHeader(TEXT("Authorization"), "Basic " + APIKey);
-		Request->SetVerb("GET");
-		FString ServerName, MapName, GameMode;
-		Session->SessionSettings.Get("SERVERNAME", ServerName);
-		Session->SessionSettings.Get("MAPNAME", MapName);
-		Session->SessionSettings.Get("GAMEMODE", GameMode);
-		bool bPasswordProtected;
-		Session->SessionSettings.Get("PASSWORDPROTECTED", bPasswordProtected);
-		FString StrPasswordProtected = bPasswordProtected ? "true" : "false";
-
-		FOnlineSessionInfoPython* SessionInfo = (FOnlineSessionInfoPython*)Session->SessionInfo.Get();
-		int32 PlayerCount;
-		Session->SessionSettings.Get("PLAYERCOUNT", PlayerCount);
-		int32 MaxPlayers = Session->SessionSettings.NumPublicConnections;
-
-
-		UOnlineSubsystemPythonConfig* config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
-
-		Request->SetURL(FString::Printf(TEXT("http://%s/update_server?name=%s&port=%d&maxplayers=%d&pwprotected=%s&gamemode=%s&map=%s&playercount=%d"), *config->ServerAddress, *FGenericPlatformHttp::UrlEncode(ServerName), SessionInfo->HostAddr->GetPort(), Session->NumOpenPublicConnections, *FGenericPlatformHttp::UrlEncode(StrPasswordProtected), *FGenericPlatformHttp::UrlEncode(GameMode), *FGenericPlatformHttp::UrlEncode(MapName), PlayerCount));
-		Request->OnProcessRequestComplete().BindRaw(this, &FOnlineSessionPython::UpdateSession_ResponseReceived);
-		Request->ProcessRequest();
-		
-	}
-
-	return bWasSuccessful;
-}
-
-void FOnlineSessionPython::UpdateSession_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
-{
-	if (!Response.IsValid())
-	{
-
-		TriggerOnUpdateSessionCompleteDelegates(CreateSessionName, false);
-		UE_LOG_ONLINE_SESSION(Error, TEXT("Error Creating Python Session! No Response from Master Server"));
-		return;
-	}
-	TSharedPtr<FJsonObject> JsonObject;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(Reader, JsonObject))
-	{
-		//Get the value of the json object by field name
-		bool bError = JsonObject->GetBoolField("error");
-		if (!bError)
+		SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::UpdateServer, Build);
 		{
-			TriggerOnUpdateSessionCompleteDelegates(CreateSessionName, true);
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Updated Python Session!"));
+			// bUsesPresence may have changed
+			FScopeLock ScopeLock(&SessionLock);
+			Session->SessionSettings = UpdatedSessionSettings;
+			SessionLookup.Publish(Sessions);
 		}
-		else
+		InvalidateLANPayload(SessionName);
+		if (Session->SessionState != EOnlineSessionState::Creating)
 		{
-			TriggerOnUpdateSessionCompleteDelegates(CreateSessionName, false);
-			FString ErrorMessage = JsonObject->GetStringField("message");
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Error Updating Python Session! %s"), *ErrorMessage);
+			// This update already carries any pending player count
+			bPlayerCountPending = false;
 		}
+		FString Query = MakeUpdateServerQuery(*Session);
+		QueueMasterServerRequest(new FOnlineAsyncTaskPythonUpdateServer(PythonSubsystem, SessionName, Query));
 	}
+
+	return bWasSuccessful;
 }
 
 bool FOnlineSessionPython::EndSession(FName SessionName)
@@ -537,7 +510,7 @@ bool FOnlineSessionPython::EndSession(FName SessionName)
 		// Can't end a match that isn't in progress
 		if (Session->SessionState == EOnlineSessionState::InProgress)
 		{
-			Session->SessionState = EOnlineSessionState::Ended;
+			SetSessionState(*Session, EOnlineSessionState::Ended);
 
 			// If the session should be advertised and the lan beacon was destroyed, recreate
 			Result = UpdateLANStatus();
@@ -559,7 +532,7 @@ bool FOnlineSessionPython::EndSession(FName SessionName)
 	{
 		if (Session)
 		{
-			Session->SessionState = EOnlineSessionState::Ended;
+			SetSessionState(*Session, EOnlineSessionState::Ended);
 		}
 
 		TriggerOnEndSessionCompleteDelegates(SessionName, (Result == ONLINE_SUCCESS) ? true : false);
@@ -575,29 +548,27 @@ bool FOnlineSessionPython::DestroySession(FName SessionName, const FOnDestroySes
 	FNamedOnlineSession* Session = GetNamedSession(SessionName);
 	if (Session)
 	{
-		if (IsRunningDedicatedServer())
+		// Any session we registered with the master server is unregistered, whether hosted by a dedicated or a listen server.
+		// One still waiting on the host's login was never sent
+		const bool bRegistered = !Session->SessionSettings.bIsLANMatch && ResolveSessionHandle(CreateSessionHandle) == Session && !bRegisterAwaitingLogin;
+		FString Query;
+		if (bRegistered)
 		{
-			FHttpModule* Http = &FHttpModule::Get();
-			TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
-			Request->SetHeader(TEXT("User-Agent"), TEXT("X-UnrealEngine-Agent"));
-			Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-			//Request->SetHeader(TEXT("Authorization"), "Basic " + APIKey);
-			Request->SetVerb("GET");
+			SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::UnregisterServer, Build);
 			FOnlineSessionInfoPython* SessionInfo = (FOnlineSessionInfoPython*)Session->SessionInfo.Get();
-			UOnlineSubsystemPythonConfig* config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
-			Request->SetURL(FString::Printf(TEXT("http://%s/unregister_server?port=%d"), *config->ServerAddress, SessionInfo->HostAddr->GetPort()));
-			Request->OnProcessRequestComplete().BindRaw(this, &FOnlineSessionPython::DestroySession_ResponseReceived);
-			Request->ProcessRequest();
-			Result = ONLINE_IO_PENDING;
+			Query = FString::Printf(TEXT("?id=%s&port=%d"), *SessionInfo->SessionId.ToString(), SessionInfo->HostAddr->GetPort());
 		}
-		else
-		{
-			// The session info is no longer needed
-			RemoveNamedSession(Session->SessionName);
 
-			Result = UpdateLANStatus();
+		// The session goes straight away so it can be created again without waiting on the master server,
+		// the heartbeat stops on its own once the session no longer resolves
+		RemoveNamedSession(SessionName);
+		Result = UpdateLANStatus();
+
+		if (bRegistered)
+		{
+			QueueMasterServerRequest(new FOnlineAsyncTaskPythonUnregisterServer(PythonSubsystem, SessionName, Query, CompletionDelegate));
+			Result = ONLINE_IO_PENDING;
 		}
-		
 	}
 	else
 	{
@@ -614,59 +585,156 @@ bool FOnlineSessionPython::DestroySession(FName SessionName, const FOnDestroySes
 	return Result == ONLINE_SUCCESS || Result == ONLINE_IO_PENDING;
 }
 
-void FOnlineSessionPython::DestroySession_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
+int32 FOnlineSessionPython::GetAdvertisedPlayerCount(const FNamedOnlineSession& Session) const
 {
-	if (!Response.IsValid())
+	// The registered count is never written to the settings, a copy of them passed to UpdateSession would carry it stale
+	int32 PlayerCount = 0;
+	if (!Session.SessionSettings.Get(FName(TEXT("PLAYERCOUNT")), PlayerCount))
 	{
-
-		TriggerOnDestroySessionCompleteDelegates(CreateSessionName, false);
-		UE_LOG_ONLINE_SESSION(Error, TEXT("Error destroying Python Session! No Response from Master Server"));
-		return;
+		PlayerCount = Session.RegisteredPlayers.Num();
 	}
-	TSharedPtr<FJsonObject> JsonObject;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(Reader, JsonObject))
+	return PlayerCount;
+}
+
+FString FOnlineSessionPython::MakeUpdateServerQuery(const FNamedOnlineSession& Session) const
+{
+	FString ServerName, MapName, GameMode;
+	Session.SessionSettings.Get("SERVERNAME", ServerName);
+	Session.SessionSettings.Get("MAPNAME", MapName);
+	Session.SessionSettings.Get("GAMEMODE", GameMode);
+	FString Region;
+	Session.SessionSettings.Get("REGION", Region);
+	bool bPasswordProtected = false;
+	Session.SessionSettings.Get("PASSWORDPROTECTED", bPasswordProtected);
+	FString StrPasswordProtected = bPasswordProtected ? "true" : "false";
+
+	FOnlineSessionInfoPython* SessionInfo = (FOnlineSessionInfoPython*)Session.SessionInfo.Get();
+	int32 MaxPlayers = Session.SessionSettings.NumPublicConnections;
+	int32 PlayerCount = GetAdvertisedPlayerCount(Session);
+
+	return FString::Printf(TEXT("?id=%s&name=%s&port=%d&maxplayers=%d&pwprotected=%s&gamemode=%s&map=%s&playercount=%d&players=%s&region=%s"), *SessionInfo->SessionId.ToString(), *FGenericPlatformHttp::UrlEncode(ServerName), SessionInfo->HostAddr->GetPort(), MaxPlayers, *FGenericPlatformHttp::UrlEncode(StrPasswordProtected), *FGenericPlatformHttp::UrlEncode(GameMode), *FGenericPlatformHttp::UrlEncode(MapName), PlayerCount, *MakePlayersQueryValue(Session), *FGenericPlatformHttp::UrlEncode(Region));
+}
+
+FString FOnlineSessionPython::MakePlayersQueryValue(const FNamedOnlineSession& Session) const
+{
+	// Python ids are hex digits, so the list needs no encoding
+	FString Players;
+	Players.Reserve(Session.RegisteredPlayers.Num() * (FUniqueNetIdPython::IdSize * 2 + 1));
+	for (const TSharedRef<const FUniqueNetId>& PlayerId : Session.RegisteredPlayers)
 	{
-		//Get the value of the json object by field name
-		bool bError = JsonObject->GetBoolField("error");
-		if (!bError)
+		if (PlayerId->GetType() != FUniqueNetIdPython::GetTypeName())
 		{
-			TriggerOnDestroySessionCompleteDelegates(CreateSessionName, true);
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Destroyed Python Session!"));
+			continue;
 		}
-		else
+		if (!Players.IsEmpty())
+		{
+			Players += TEXT(",");
+		}
+		Players += PlayerId->ToString();
+	}
+	return Players;
+}
+
+int32 FOnlineSessionPython::GetLocalUserNum(const FUniqueNetId& UserId) const
+{
+	IOnlineIdentityPtr Identity = PythonSubsystem->GetIdentityInterface();
+	if (Identity.IsValid() && UserId.IsValid())
+	{
+		const FPlatformUserId PlatformUserId = Identity->GetPlatformUserIdFromUniqueNetId(UserId);
+		if (PlatformUserId != PLATFORMUSERID_NONE)
 		{
-			TriggerOnDestroySessionCompleteDelegates(CreateSessionName, false);
-			FString ErrorMessage = JsonObject->GetStringField("message");
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Error destroying Python Session! %s"), *ErrorMessage);
+			return PlatformUserId;
 		}
 	}
+	return 0;
 }
 
 bool FOnlineSessionPython::IsPlayerInSession(FName SessionName, const FUniqueNetId& UniqueId)
 {
-	return IsPlayerInSessionImpl(this, SessionName, UniqueId);
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr)
+	{
+		return false;
+	}
+
+	const bool bIsSessionOwner = Session->OwningUserId.IsValid() && *Session->OwningUserId == UniqueId;
+	return bIsSessionOwner || SessionMembers.FindOrAdd(SessionName).Find(*Session, UniqueId) != INDEX_NONE;
 }
 
 bool FOnlineSessionPython::StartMatchmaking(const TArray< TSharedRef<const FUniqueNetId> >& LocalPlayers, FName SessionName, const FOnlineSessionSettings& NewSessionSettings, TSharedRef<FOnlineSessionSearch>& SearchSettings)
 {
-	UE_LOG_ONLINE_SESSION(Warning, TEXT("StartMatchmaking is not supported on this platform. Use FindSessions or FindSessionById."));
-	TriggerOnMatchmakingCompleteDelegates(SessionName, false);
-	return false;
+	// Slots are held for these players until the host registers them
+	FString Players;
+	int32 LocalUserNum = 0;
+	for (const TSharedRef<const FUniqueNetId>& Player : LocalPlayers)
+	{
+		if (Player->GetType() != FUniqueNetIdPython::GetTypeName() || !Player->IsValid())
+		{
+			continue;
+		}
+		if (Players.IsEmpty())
+		{
+			LocalUserNum = GetLocalUserNum(*Player);
+		}
+		else
+		{
+			Players += TEXT(",");
+		}
+		Players += Player->ToString();
+	}
+
+	if (Players.IsEmpty() || MatchmakingTask != nullptr || GetNamedSession(SessionName) != nullptr || IsBackingOffFromMasterServer())
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Can't start matchmaking for session (%s)"), *SessionName.ToString());
+		TriggerOnMatchmakingCompleteDelegates(SessionName, false);
+		return false;
+	}
+
+	// Only servers running the game mode are considered, the map and region make a server more likely to be picked
+	FString GameMode, MapName, Region;
+	SearchSettings->QuerySettings.Get(SETTING_GAMEMODE, GameMode);
+	SearchSettings->QuerySettings.Get(SETTING_MAPNAME, MapName);
+	SearchSettings->QuerySettings.Get(FName(TEXT("REGION")), Region);
+
+	SearchSettings->SearchResults.Empty();
+	SearchSettings->SearchState = EOnlineAsyncTaskState::InProgress;
+	MatchmakingSearch = SearchSettings;
+	MatchmakingSessionName = SessionName;
+
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::Matchmake, Build);
+	FString Query = FString::Printf(TEXT("?players=%s&gamemode=%s&map=%s&region=%s"), *Players, *FGenericPlatformHttp::UrlEncode(GameMode), *FGenericPlatformHttp::UrlEncode(MapName), *FGenericPlatformHttp::UrlEncode(Region));
+	MatchmakingTask = new FOnlineAsyncTaskPythonMatchmake(PythonSubsystem, LocalUserNum, SessionName, Query);
+	QueueMasterServerRequest(MatchmakingTask);
+	return true;
 }
 
 bool FOnlineSessionPython::CancelMatchmaking(int32 SearchingPlayerNum, FName SessionName)
 {
-	UE_LOG_ONLINE_SESSION(Warning, TEXT("CancelMatchmaking is not supported on this platform. Use CancelFindSessions."));
-	TriggerOnCancelMatchmakingCompleteDelegates(SessionName, false);
-	return false;
+	bool bCancelled = false;
+	if (MatchmakingTask != nullptr && MatchmakingSessionName == SessionName)
+	{
+		// The request completes as failed without joining
+		MatchmakingTask->Cancel();
+		MatchmakingTask = nullptr;
+		if (MatchmakingSearch.IsValid())
+		{
+			MatchmakingSearch->SearchState = EOnlineAsyncTaskState::Failed;
+			MatchmakingSearch = nullptr;
+		}
+		bCancelled = true;
+	}
+	else
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Can't cancel matchmaking for session (%s), it isn't matchmaking"), *SessionName.ToString());
+	}
+
+	TriggerOnCancelMatchmakingCompleteDelegates(SessionName, bCancelled);
+	return bCancelled;
 }
 
 bool FOnlineSessionPython::CancelMatchmaking(const FUniqueNetId& SearchingPlayerId, FName SessionName)
 {
-	UE_LOG_ONLINE_SESSION(Warning, TEXT("CancelMatchmaking is not supported on this platform. Use CancelFindSessions."));
-	TriggerOnCancelMatchmakingCompleteDelegates(SessionName, false);
-	return false;
+	return CancelMatchmaking(GetLocalUserNum(SearchingPlayerId), SessionName);
 }
 
 bool FOnlineSessionPython::FindSessions(int32 SearchingPlayerNum, const TSharedRef<FOnlineSessionSearch>& SearchSettings)
@@ -685,7 +753,14 @@ bool FOnlineSessionPython::FindSessions(int32 SearchingPlayerNum, const TSharedR
 		// remember the time at which we started search, as this will be used for a "good enough" ping estimation
 		SessionSearchStartInSeconds = FPlatformTime::Seconds();
 
-		if (SearchSettings->bIsLanQuery)
+		bool bSearchLANAndInternet = false;
+		SearchSettings->QuerySettings.Get(SEARCH_PYTHON_LAN_AND_INTERNET, bSearchLANAndInternet);
+
+		if (bSearchLANAndInternet)
+		{
+			Return = FindHybridSessions();
+		}
+		else if (SearchSettings->bIsLanQuery)
 		{
 			// Check if its a LAN query
 			Return = FindLANSession();
@@ -697,17 +772,22 @@ bool FOnlineSessionPython::FindSessions(int32 SearchingPlayerNum, const TSharedR
 		}
 		else
 		{
-			FHttpModule* Http = &FHttpModule::Get();
-			TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
-			Request->SetHeader(TEXT("User-Agent"), TEXT("X-UnrealEngine-Agent"));
-			Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-			//Request->SetHeader(TEXT("Authorization"), "Basic " + APIKey);
-			Request->SetVerb("GET");
-			UOnlineSubsystemPythonConfig* config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
-			Request->SetURL(FString::Printf(TEXT("http://%s/get_serverlist"), *config->ServerAddress));
-			Request->OnProcessRequestComplete().BindRaw(this, &FOnlineSessionPython::FindSessions_ResponseReceived);
-			Request->ProcessRequest();
-			Return = ONLINE_IO_PENDING;
+			if (IsBackingOffFromMasterServer())
+			{
+				// Fail fast rather than adding to the load the master server is shedding
+				UE_LOG_ONLINE_SESSION(Warning, TEXT("Not finding Python Sessions, the master server asked to retry in %.0f seconds"), MasterServerBackoffEndTime - FPlatformTime::Seconds());
+				SearchSettings->SearchState = EOnlineAsyncTaskState::Failed;
+				CurrentSessionSearch = nullptr;
+				TriggerOnFindSessionsCompleteDelegates(false);
+			}
+			else
+			{
+				SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::GetServerList, Build);
+				ServerListTask = new FOnlineAsyncTaskPythonGetServerList(PythonSubsystem);
+				QueueMasterServerRequest(ServerListTask);
+				SearchSettings->SearchState = EOnlineAsyncTaskState::InProgress;
+				Return = ONLINE_IO_PENDING;
+			}
 		}
 		
 	}
@@ -728,66 +808,181 @@ bool FOnlineSessionPython::FindSessions(const FUniqueNetId& SearchingPlayerId, c
 
 bool FOnlineSessionPython::FindSessionById(const FUniqueNetId& SearchingUserId, const FUniqueNetId& SessionId, const FUniqueNetId& FriendId, const FOnSingleSessionResultCompleteDelegate& CompletionDelegates)
 {
-	FOnlineSessionSearchResult EmptyResult;
-	CompletionDelegates.ExecuteIfBound(0, false, EmptyResult);
+	const int32 LocalUserNum = GetLocalUserNum(SearchingUserId);
+	const FUniqueNetIdPython PythonSessionId(SessionId);
+	if (!PythonSessionId.IsValid() || IsBackingOffFromMasterServer())
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Can't find Python session %s"), *SessionId.ToDebugString());
+		FOnlineSessionSearchResult EmptyResult;
+		CompletionDelegates.ExecuteIfBound(LocalUserNum, false, EmptyResult);
+		return false;
+	}
+
+	// One server's record rather than the whole list, so rejoining or following an invite stays cheap
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::GetServer, Build);
+	QueueMasterServerRequest(new FOnlineAsyncTaskPythonGetServer(PythonSubsystem, LocalUserNum, PythonSessionId, CompletionDelegates));
 	return true;
 }
 
-void FOnlineSessionPython::FindSessions_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful)
+uint32 FOnlineSessionPython::FindHybridSessions()
+{
+	bHybridSearch = true;
+	bHybridSearchSucceeded = false;
+	HybridSearchDeadlineInSeconds = SessionSearchStartInSeconds + HybridSearchDeadlineSeconds;
+	HybridResultsBySessionId.Reset();
+	HybridResultsByHostAddr.Reset();
+	HybridResultFromLAN.Reset();
+
+	// Both halves add to the same search results, whichever finishes last completes the search
+	bHybridLANPending = FindLANSession() == ONLINE_IO_PENDING;
+	bHybridSearchSucceeded = bHybridLANPending;
+
+	if (IsBackingOffFromMasterServer())
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Only searching LAN, the master server asked to retry in %.0f seconds"), MasterServerBackoffEndTime - FPlatformTime::Seconds());
+		bHybridInternetPending = false;
+	}
+	else
+	{
+		SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::GetServerList, Build);
+		ServerListTask = new FOnlineAsyncTaskPythonGetServerList(PythonSubsystem);
+		QueueMasterServerRequest(ServerListTask);
+		bHybridInternetPending = true;
+	}
+
+	if (!bHybridLANPending && !bHybridInternetPending)
+	{
+		TryCompleteHybridSearch();
+		return ONLINE_FAIL;
+	}
+
+	CurrentSessionSearch->SearchState = EOnlineAsyncTaskState::InProgress;
+	return ONLINE_IO_PENDING;
+}
+
+void FOnlineSessionPython::TickHybridSearch()
 {
-	if (!Response.IsValid())
+	if (!bHybridSearch || FPlatformTime::Seconds() < HybridSearchDeadlineInSeconds)
 	{
+		return;
+	}
+
+	UE_LOG_ONLINE_SESSION(Verbose, TEXT("Combined search deadline hit with LAN %s and internet %s"),
+		bHybridLANPending ? TEXT("pending") : TEXT("done"),
+		bHybridInternetPending ? TEXT("pending") : TEXT("done"));
+
+	if (bHybridLANPending)
+	{
+		FinalizeLANSearch();
+		bHybridLANPending = false;
+	}
+	if (bHybridInternetPending)
+	{
+		CancelServerListRequest();
+		bHybridInternetPending = false;
+	}
+	TryCompleteHybridSearch();
+}
 
-		TriggerOnFindSessionsCompleteDelegates(true);
-		UE_LOG_ONLINE_SESSION(Error, TEXT("Error finding Python Sessions! No Response from Master Server"));
+void FOnlineSessionPython::TryCompleteHybridSearch()
+{
+	if (!bHybridSearch || bHybridLANPending || bHybridInternetPending)
+	{
 		return;
 	}
 
-	TSharedPtr<FJsonObject> JsonObject;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
-	if (FJsonSerializer::Deserialize(Reader, JsonObject))
+	bHybridSearch = false;
+	HybridResultsBySessionId.Reset();
+	HybridResultsByHostAddr.Reset();
+	HybridResultFromLAN.Reset();
+
+	if (CurrentSessionSearch.IsValid())
 	{
-		//Get the value of the json object by field name
-		bool bError = JsonObject->GetBoolField("error");
-		if (!bError)
+		if (CurrentSessionSearch->SearchResults.Num() > 0)
 		{
-			
-			TArray <TSharedPtr<FJsonValue>> JsonServerList = JsonObject->GetArrayField("servers");
-			for (int32 i = 0; i != JsonServerList.Num(); i++)
-			{
-				FOnlineSessionSearchResult SearchResult;
-				TSharedPtr<FOnlineSessionInfoPython> SessionInfo = MakeShareable(new FOnlineSessionInfoPython());;
-				auto server = JsonServerList[i]->AsObject();
-				TSharedPtr<FInternetAddr> InternetAddress = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
-				InternetAddress->SetPort(server->GetIntegerField("port"));
-				bool bIsValid;
-				InternetAddress->SetIp(*server->GetStringField("ip"), bIsValid);
-				SessionInfo->HostAddr = InternetAddress;
-				SearchResult.Session.SessionInfo = SessionInfo;
-				SearchResult.Session.NumOpenPublicConnections = server->GetIntegerField("maxplayers");
-				SearchResult.Session.SessionSettings.Set(SETTING_MAPNAME, *server->GetStringField("mapname"));
-				SearchResult.Session.SessionSettings.Set(SETTING_GAMEMODE, *server->GetStringField("gamemode"));
-				SearchResult.Session.SessionSettings.Set("SERVERNAME", *server->GetStringField("name"));
-				SearchResult.Session.SessionSettings.Set(FName(TEXT("PASSWORDPROTECTED")), server->GetStringField("pwprotected"));
-				SearchResult.Session.SessionSettings.Set("PLAYERCOUNT", server->GetIntegerField("playercount"));
-				SearchResult.Session.SessionSettings.Set("MAXPLAYERS", server->GetIntegerField("maxplayers"));
-
-				CurrentSessionSearch->SearchResults.Add(SearchResult);
-			}
-			TriggerOnFindSessionsCompleteDelegates(true);
-			CurrentSessionSearch = nullptr;
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Found Python Sessions!"));
+			// Allow game code to sort the servers
+			CurrentSessionSearch->SortSearchResults();
 		}
-		else
+		CurrentSessionSearch->SearchState = bHybridSearchSucceeded ? EOnlineAsyncTaskState::Done : EOnlineAsyncTaskState::Failed;
+		CurrentSessionSearch = nullptr;
+	}
+
+	TriggerOnFindSessionsCompleteDelegates(bHybridSearchSucceeded);
+}
+
+void FOnlineSessionPython::CancelServerListRequest()
+{
+	// Cleared, so the cancelled request's completion is recognised as stale. The task is still alive until its Finalize,
+	// which can't have run while it was the outstanding request
+	if (ServerListTask)
+	{
+		ServerListTask->Cancel();
+		ServerListTask = nullptr;
+	}
+}
+
+/** Gets what identifies the host of a search result: its session id, when known, and its address */
+static void GetSearchResultKeys(const FOnlineSessionSearchResult& Result, FUniqueNetIdPython& OutSessionId, FString& OutHostAddr)
+{
+	TSharedPtr<FOnlineSessionInfoPython> SessionInfo = StaticCastSharedPtr<FOnlineSessionInfoPython>(Result.Session.SessionInfo);
+	if (!SessionInfo.IsValid())
+	{
+		return;
+	}
+
+	// Results from LAN and from the master server both carry the session id the host generated, older master servers leave it invalid
+	OutSessionId = SessionInfo->SessionId;
+	if (SessionInfo->HostAddr.IsValid() && SessionInfo->HostAddr->IsValid())
+	{
+		OutHostAddr = SessionInfo->HostAddr->ToString(true);
+	}
+}
+
+void FOnlineSessionPython::AddSearchResult(FOnlineSessionSearchResult&& Result, bool bFromLAN)
+{
+	TArray<FOnlineSessionSearchResult>& SearchResults = CurrentSessionSearch->SearchResults;
+	if (!bHybridSearch)
+	{
+		SearchResults.Add(MoveTemp(Result));
+		return;
+	}
+
+	FUniqueNetIdPython SessionId;
+	FString HostAddr;
+	GetSearchResultKeys(Result, SessionId, HostAddr);
+
+	const int32* ExistingIndex = SessionId.IsValid() ? HybridResultsBySessionId.Find(SessionId) : nullptr;
+	if (ExistingIndex == nullptr && !HostAddr.IsEmpty())
+	{
+		ExistingIndex = HybridResultsByHostAddr.Find(HostAddr);
+	}
+
+	int32 Index = INDEX_NONE;
+	if (ExistingIndex)
+	{
+		Index = *ExistingIndex;
+		// A LAN result has a measured ping and the host's own settings, keep it over the master server's copy
+		if (HybridResultFromLAN[Index] && !bFromLAN)
 		{
-			TriggerOnFindSessionsCompleteDelegates(false);
-			FString ErrorMessage = JsonObject->GetStringField("message");
-			UE_LOG_ONLINE_SESSION(Warning, TEXT("Error finding Python Sessions! %s"), *ErrorMessage);
-			CurrentSessionSearch = nullptr;
+			return;
 		}
+		SearchResults[Index] = MoveTemp(Result);
+		HybridResultFromLAN[Index] = bFromLAN;
+	}
+	else
+	{
+		Index = SearchResults.Add(MoveTemp(Result));
+		HybridResultFromLAN.Add(bFromLAN);
+	}
+
+	if (SessionId.IsValid())
+	{
+		HybridResultsBySessionId.Add(SessionId, Index);
+	}
+	if (!HostAddr.IsEmpty())
+	{
+		HybridResultsByHostAddr.Add(HostAddr, Index);
 	}
-	CurrentSessionSearch = nullptr;
-	TriggerOnFindSessionsCompleteDelegates(false);
 }
 
 uint32 FOnlineSessionPython::FindLANSession()
@@ -797,6 +992,13 @@ uint32 FOnlineSessionPython::FindLANSession()
 	// Recreate the unique identifier for this client
 	GenerateNonce((uint8*)&LANSessionManager.LanNonce, 8);
 
+	// Nothing has answered yet
+	LastLANResponseInSeconds = SessionSearchStartInSeconds;
+	LANResponseGapInSeconds = 0.0;
+	NumLANResponses = 0;
+	bLANResponseMoreFollows = false;
+	NumLANResultsNotified = 0;
+
 	FOnValidResponsePacketDelegate ResponseDelegate = FOnValidResponsePacketDelegate::CreateRaw(this, &FOnlineSessionPython::OnValidResponsePacketReceived);
 	FOnSearchingTimeoutDelegate TimeoutDelegate = FOnSearchingTimeoutDelegate::CreateRaw(this, &FOnlineSessionPython::OnLANSearchTimeout);
 
@@ -808,10 +1010,14 @@ uint32 FOnlineSessionPython::FindLANSession()
 
 		FinalizeLANSearch();
 
-		CurrentSessionSearch->SearchState = EOnlineAsyncTaskState::Failed;
-		
-		// Just trigger the delegate as having failed
-		TriggerOnFindSessionsCompleteDelegates(false);
+		// A combined search carries on with the master server
+		if (!bHybridSearch)
+		{
+			CurrentSessionSearch->SearchState = EOnlineAsyncTaskState::Failed;
+
+			// Just trigger the delegate as having failed
+			TriggerOnFindSessionsCompleteDelegates(false);
+		}
 	}
 	return Return;
 }
@@ -825,6 +1031,10 @@ bool FOnlineSessionPython::CancelFindSessions()
 		Return = ONLINE_SUCCESS;
 
 		FinalizeLANSearch();
+		CancelServerListRequest();
+		bHybridSearch = false;
+		bHybridLANPending = false;
+		bHybridInternetPending = false;
 
 		CurrentSessionSearch->SearchState = EOnlineAsyncTaskState::Failed;
 		CurrentSessionSearch = NULL;
@@ -843,6 +1053,11 @@ bool FOnlineSessionPython::CancelFindSessions()
 }
 
 bool FOnlineSessionPython::JoinSession(int32 PlayerNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession)
+{
+	return JoinPythonSession(PlayerNum, SessionName, DesiredSession, true);
+}
+
+bool FOnlineSessionPython::JoinPythonSession(int32 PlayerNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession, bool bReserveSlot)
 {
 	uint32 Return = ONLINE_FAIL;
 	FNamedOnlineSession* Session = GetNamedSession(SessionName);
@@ -862,6 +1077,19 @@ bool FOnlineSessionPython::JoinSession(int32 PlayerNum, FName SessionName, const
 		// turn off advertising on Join, to avoid clients advertising it over LAN
 		Session->SessionSettings.bShouldAdvertise = false;
 
+		// Hold a slot before joining a listed server, so players who all saw its last slot don't all connect to it
+		const FOnlineSessionInfoPython* SessionInfo = (const FOnlineSessionInfoPython*)Session->SessionInfo.Get();
+		IOnlineIdentityPtr Identity = PythonSubsystem->GetIdentityInterface();
+		TSharedPtr<const FUniqueNetId> PlayerId = Identity.IsValid() ? Identity->GetUniquePlayerId(PlayerNum) : nullptr;
+		if (Return == ONLINE_SUCCESS && bReserveSlot && !DesiredSession.Session.SessionSettings.bIsLANMatch &&
+			SessionInfo->SessionId.IsValid() && PlayerId.IsValid() && PlayerId->IsValid() && !IsBackingOffFromMasterServer())
+		{
+			SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::ReserveSlot, Build);
+			Return = ONLINE_IO_PENDING;
+			FString Query = FString::Printf(TEXT("?id=%s&players=%s"), *SessionInfo->SessionId.ToString(), *PlayerId->ToString());
+			QueueMasterServerRequest(new FOnlineAsyncTaskPythonReserveSlot(PythonSubsystem, SessionName, GetSessionHandle(Session), Query));
+		}
+
 		if (Return != ONLINE_IO_PENDING)
 		{
 			if (Return != ONLINE_SUCCESS)
@@ -892,63 +1120,138 @@ bool FOnlineSessionPython::JoinSession(int32 PlayerNum, FName SessionName, const
 bool FOnlineSessionPython::JoinSession(const FUniqueNetId& PlayerId, FName SessionName, const FOnlineSessionSearchResult& DesiredSession)
 {
 	// Assuming player 0 should be OK here
-	return JoinSession(0, SessionName, DesiredSession);
+	return JoinPythonSession(0, SessionName, DesiredSession, true);
 }
 
 bool FOnlineSessionPython::FindFriendSession(int32 LocalUserNum, const FUniqueNetId& Friend)
 {
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	TArray<FOnlineSessionSearchResult> EmptySearchResult;
-	TriggerOnFindFriendSessionCompleteDelegates(LocalUserNum, false, EmptySearchResult);
-	return false;
+	TArray<TSharedRef<const FUniqueNetId>> FriendList;
+	FriendList.Add(MakeShared<FUniqueNetIdPython>(Friend));
+	return FindFriendSessions(LocalUserNum, FriendList);
 };
 
 bool FOnlineSessionPython::FindFriendSession(const FUniqueNetId& LocalUserId, const FUniqueNetId& Friend)
 {
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	TArray<FOnlineSessionSearchResult> EmptySearchResult;
-	TriggerOnFindFriendSessionCompleteDelegates(0, false, EmptySearchResult);
-	return false;
+	TArray<TSharedRef<const FUniqueNetId>> FriendList;
+	FriendList.Add(MakeShared<FUniqueNetIdPython>(Friend));
+	return FindFriendSessions(GetLocalUserNum(LocalUserId), FriendList);
 }
 
 bool FOnlineSessionPython::FindFriendSession(const FUniqueNetId& LocalUserId, const TArray<TSharedRef<const FUniqueNetId>>& FriendList)
 {
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	TArray<FOnlineSessionSearchResult> EmptySearchResult;
-	TriggerOnFindFriendSessionCompleteDelegates(0, false, EmptySearchResult);
-	return false;
+	return FindFriendSessions(GetLocalUserNum(LocalUserId), FriendList);
 }
 
-bool FOnlineSessionPython::SendSessionInviteToFriend(int32 LocalUserNum, FName SessionName, const FUniqueNetId& Friend)
-{
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	return false;
-};
-
-bool FOnlineSessionPython::SendSessionInviteToFriend(const FUniqueNetId& LocalUserId, FName SessionName, const FUniqueNetId& Friend)
+bool FOnlineSessionPython::FindFriendSessions(int32 LocalUserNum, const TArray<TSharedRef<const FUniqueNetId>>& FriendList)
 {
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	return false;
-}
+	// The master server indexes the players hosts register, so the whole list resolves in one request
+	FString Players;
+	int32 NumFriends = 0;
+	for (const TSharedRef<const FUniqueNetId>& Friend : FriendList)
+	{
+		if (Friend->GetType() != FUniqueNetIdPython::GetTypeName() || !Friend->IsValid())
+		{
+			continue;
+		}
+		if (NumFriends == MaxFriendsPerLookup)
+		{
+			UE_LOG_ONLINE_SESSION(Warning, TEXT("Only looking up the sessions of the first %d of %d friends"), MaxFriendsPerLookup, FriendList.Num());
+			break;
+		}
+		if (NumFriends++ > 0)
+		{
+			Players += TEXT(",");
+		}
+		Players += Friend->ToString();
+	}
 
-bool FOnlineSessionPython::SendSessionInviteToFriends(int32 LocalUserNum, FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Friends)
-{
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	return false;
-};
+	if (NumFriends == 0 || IsBackingOffFromMasterServer())
+	{
+		TArray<FOnlineSessionSearchResult> EmptySearchResult;
+		TriggerOnFindFriendSessionCompleteDelegates(LocalUserNum, false, EmptySearchResult);
+		return false;
+	}
 
-bool FOnlineSessionPython::SendSessionInviteToFriends(const FUniqueNetId& LocalUserId, FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Friends)
-{
-	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
-	return false;
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::FindFriendSessions, Build);
+	QueueMasterServerRequest(new FOnlineAsyncTaskPythonFindFriendSessions(PythonSubsystem, LocalUserNum, FString::Printf(TEXT("?players=%s"), *Players)));
+	return true;
 }
 
-uint32 FOnlineSessionPython::JoinLANSession(int32 PlayerNum, FNamedOnlineSession* Session, const FOnlineSession* SearchSession)
+bool FOnlineSessionPython::FindGroupSession(int32 LocalUserNum, const TArray<TSharedRef<const FUniqueNetId>>& GroupMembers, const FOnlineSessionSearch* SearchSettings, const FOnlineSessionSearchResult* DesiredSession, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate)
+{
+	FString Players;
+	int32 NumMembers = 0;
+	for (const TSharedRef<const FUniqueNetId>& Member : GroupMembers)
+	{
+		if (Member->GetType() != FUniqueNetIdPython::GetTypeName() || !Member->IsValid())
+		{
+			continue;
+		}
+		if (NumMembers++ > 0)
+		{
+			Players += TEXT(",");
+		}
+		Players += Member->ToString();
+	}
+
+	// The whole group has to fit, finding room for only some of it would split it up
+	FString SessionId;
+	if (DesiredSession != nullptr && DesiredSession->Session.SessionInfo.IsValid())
+	{
+		SessionId = ((const FOnlineSessionInfoPython*)DesiredSession->Session.SessionInfo.Get())->SessionId.ToString();
+	}
+	if (NumMembers == 0 || NumMembers > MaxGroupSize || (DesiredSession != nullptr && SessionId.IsEmpty()) || IsBackingOffFromMasterServer())
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Can't find a session for a group of %d players"), GroupMembers.Num());
+		FOnlineSessionSearchResult EmptyResult;
+		CompletionDelegate.ExecuteIfBound(LocalUserNum, false, EmptyResult);
+		return false;
+	}
+
+	FString GameMode, MapName, Region;
+	if (SearchSettings != nullptr)
+	{
+		SearchSettings->QuerySettings.Get(SETTING_GAMEMODE, GameMode);
+		SearchSettings->QuerySettings.Get(SETTING_MAPNAME, MapName);
+		SearchSettings->QuerySettings.Get(FName(TEXT("REGION")), Region);
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::GroupJoin, Build);
+	FString Query = FString::Printf(TEXT("?players=%s&id=%s&gamemode=%s&map=%s&region=%s"), *Players, *SessionId, *FGenericPlatformHttp::UrlEncode(GameMode), *FGenericPlatformHttp::UrlEncode(MapName), *FGenericPlatformHttp::UrlEncode(Region));
+	QueueMasterServerRequest(new FOnlineAsyncTaskPythonGroupJoin(PythonSubsystem, LocalUserNum, Query, CompletionDelegate));
+	return true;
+}
+
+bool FOnlineSessionPython::SendSessionInviteToFriend(int32 LocalUserNum, FName SessionName, const FUniqueNetId& Friend)
+{
+	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
+	return false;
+};
+
+bool FOnlineSessionPython::SendSessionInviteToFriend(const FUniqueNetId& LocalUserId, FName SessionName, const FUniqueNetId& Friend)
+{
+	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
+	return false;
+}
+
+bool FOnlineSessionPython::SendSessionInviteToFriends(int32 LocalUserNum, FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Friends)
+{
+	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
+	return false;
+};
+
+bool FOnlineSessionPython::SendSessionInviteToFriends(const FUniqueNetId& LocalUserId, FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Friends)
+{
+	// this function has to exist due to interface definition, but it does not have a meaningful implementation in Python subsystem
+	return false;
+}
+
+uint32 FOnlineSessionPython::JoinLANSession(int32 PlayerNum, FNamedOnlineSession* Session, const FOnlineSession* SearchSession)
 {
 	check(Session != nullptr);
 
 	uint32 Result = ONLINE_FAIL;
-	Session->SessionState = EOnlineSessionState::Pending;
+	SetSessionState(*Session, EOnlineSessionState::Pending);
 
 	if (Session->SessionInfo.IsValid() && SearchSession != nullptr && SearchSession->SessionInfo.IsValid())
 	{
@@ -1113,47 +1416,25 @@ void FOnlineSessionPython::UnregisterVoice(const FUniqueNetId& PlayerId)
 
 bool FOnlineSessionPython::RegisterPlayer(FName SessionName, const FUniqueNetId& PlayerId, bool bWasInvited)
 {
+	// A registered player is passed on with the id the session already holds, only a new player's id is copied
 	TArray< TSharedRef<const FUniqueNetId> > Players;
-	Players.Add(MakeShareable(new FUniqueNetIdPython(PlayerId)));
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	const int32 PlayerIndex = Session ? SessionMembers.FindOrAdd(SessionName).Find(*Session, PlayerId) : INDEX_NONE;
+	if (PlayerIndex != INDEX_NONE)
+	{
+		Players.Add(Session->RegisteredPlayers[PlayerIndex]);
+	}
+	else
+	{
+		Players.Add(MakeShareable(new FUniqueNetIdPython(PlayerId)));
+	}
 	return RegisterPlayers(SessionName, Players, bWasInvited);
 }
 
 bool FOnlineSessionPython::RegisterPlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Players, bool bWasInvited)
 {
-	bool bSuccess = false;
-	FNamedOnlineSession* Session = GetNamedSession(SessionName);
-	if (Session)
-	{
-		bSuccess = true;
-
-		for (int32 PlayerIdx=0; PlayerIdx<Players.Num(); PlayerIdx++)
-		{
-			const TSharedRef<const FUniqueNetId>& PlayerId = Players[PlayerIdx];
-
-			FUniqueNetIdMatcher PlayerMatch(*PlayerId);
-			if (Session->RegisteredPlayers.IndexOfByPredicate(PlayerMatch) == INDEX_NONE)
-			{
-				Session->RegisteredPlayers.Add(PlayerId);
-				RegisterVoice(*PlayerId);
-
-				// update number of open connections
-				if (Session->NumOpenPublicConnections > 0)
-				{
-					Session->NumOpenPublicConnections--;
-				}
-				else if (Session->NumOpenPrivateConnections > 0)
-				{
-					Session->NumOpenPrivateConnections--;
-				}
-			}
-			else
-			{
-				RegisterVoice(*PlayerId);
-				UE_LOG_ONLINE_SESSION(Log, TEXT("Player %s already registered in session %s"), *PlayerId->ToDebugString(), *SessionName.ToString());
-			}			
-		}
-	}
-	else
+	const bool bSuccess = ApplyPlayerChanges(SessionName, Players, TArray< TSharedRef<const FUniqueNetId> >());
+	if (!bSuccess)
 	{
 		UE_LOG_ONLINE_SESSION(Warning, TEXT("No game present to join for session (%s)"), *SessionName.ToString());
 	}
@@ -1165,66 +1446,241 @@ bool FOnlineSessionPython::RegisterPlayers(FName SessionName, const TArray< TSha
 bool FOnlineSessionPython::UnregisterPlayer(FName SessionName, const FUniqueNetId& PlayerId)
 {
 	TArray< TSharedRef<const FUniqueNetId> > Players;
-	Players.Add(MakeShareable(new FUniqueNetIdPython(PlayerId)));
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	const int32 PlayerIndex = Session ? SessionMembers.FindOrAdd(SessionName).Find(*Session, PlayerId) : INDEX_NONE;
+	if (PlayerIndex != INDEX_NONE)
+	{
+		Players.Add(Session->RegisteredPlayers[PlayerIndex]);
+	}
+	else
+	{
+		Players.Add(MakeShareable(new FUniqueNetIdPython(PlayerId)));
+	}
 	return UnregisterPlayers(SessionName, Players);
 }
 
 bool FOnlineSessionPython::UnregisterPlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Players)
 {
-	bool bSuccess = true;
+	const bool bSuccess = ApplyPlayerChanges(SessionName, TArray< TSharedRef<const FUniqueNetId> >(), Players);
+	if (!bSuccess)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("No game present to leave for session (%s)"), *SessionName.ToString());
+	}
+
+	TriggerOnUnregisterPlayersCompleteDelegates(SessionName, Players, bSuccess);
+	return bSuccess;
+}
+
+bool FOnlineSessionPython::UpdatePlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Joining, const TArray< TSharedRef<const FUniqueNetId> >& Leaving, bool bWasInvited)
+{
+	const bool bSuccess = ApplyPlayerChanges(SessionName, Joining, Leaving);
+	if (!bSuccess)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("No game present to update players for session (%s)"), *SessionName.ToString());
+	}
+
+	if (Leaving.Num() > 0)
+	{
+		TriggerOnUnregisterPlayersCompleteDelegates(SessionName, Leaving, bSuccess);
+	}
+	if (Joining.Num() > 0)
+	{
+		TriggerOnRegisterPlayersCompleteDelegates(SessionName, Joining, bSuccess);
+	}
+	return bSuccess;
+}
 
+bool FOnlineSessionPython::ApplyPlayerChanges(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Joining, const TArray< TSharedRef<const FUniqueNetId> >& Leaving)
+{
 	FNamedOnlineSession* Session = GetNamedSession(SessionName);
-	if (Session)
+	if (Session == nullptr)
+	{
+		return false;
+	}
+
+	FSessionMembersPython& Members = SessionMembers.FindOrAdd(SessionName);
+	const int32 OldPlayerCount = Session->RegisteredPlayers.Num();
+
+	for (const TSharedRef<const FUniqueNetId>& PlayerId : Leaving)
 	{
-		for (int32 PlayerIdx=0; PlayerIdx < Players.Num(); PlayerIdx++)
+		const int32 RegistrantIndex = Members.Find(*Session, *PlayerId);
+		if (RegistrantIndex != INDEX_NONE)
 		{
-			const TSharedRef<const FUniqueNetId>& PlayerId = Players[PlayerIdx];
+			Members.RemoveAtSwap(*Session, RegistrantIndex);
+			UnregisterVoice(*PlayerId);
 
-			FUniqueNetIdMatcher PlayerMatch(*PlayerId);
-			int32 RegistrantIndex = Session->RegisteredPlayers.IndexOfByPredicate(PlayerMatch);
-			if (RegistrantIndex != INDEX_NONE)
+			// update number of open connections
+			if (Session->NumOpenPublicConnections < Session->SessionSettings.NumPublicConnections)
+			{
+				Session->NumOpenPublicConnections++;
+			}
+			else if (Session->NumOpenPrivateConnections < Session->SessionSettings.NumPrivateConnections)
 			{
-				Session->RegisteredPlayers.RemoveAtSwap(RegistrantIndex);
-				UnregisterVoice(*PlayerId);
+				Session->NumOpenPrivateConnections++;
+			}
+		}
+		else
+		{
+			UE_LOG_ONLINE_SESSION(Warning, TEXT("Player %s is not part of session (%s)"), *PlayerId->ToDebugString(), *SessionName.ToString());
+		}
+	}
 
-				// update number of open connections
-				if (Session->NumOpenPublicConnections < Session->SessionSettings.NumPublicConnections)
-				{
-					Session->NumOpenPublicConnections++;
-				}
-				else if (Session->NumOpenPrivateConnections < Session->SessionSettings.NumPrivateConnections)
-				{
-					Session->NumOpenPrivateConnections++;
-				}
+	for (const TSharedRef<const FUniqueNetId>& PlayerId : Joining)
+	{
+		if (Members.Find(*Session, *PlayerId) == INDEX_NONE)
+		{
+			Members.Add(*Session, PlayerId);
+			RegisterVoice(*PlayerId);
+
+			// update number of open connections
+			if (Session->NumOpenPublicConnections > 0)
+			{
+				Session->NumOpenPublicConnections--;
 			}
-			else
+			else if (Session->NumOpenPrivateConnections > 0)
 			{
-				UE_LOG_ONLINE_SESSION(Warning, TEXT("Player %s is not part of session (%s)"), *PlayerId->ToDebugString(), *SessionName.ToString());
+				Session->NumOpenPrivateConnections--;
 			}
 		}
+		else
+		{
+			RegisterVoice(*PlayerId);
+			UE_LOG_ONLINE_SESSION(Log, TEXT("Player %s already registered in session %s"), *PlayerId->ToDebugString(), *SessionName.ToString());
+		}
 	}
-	else
+
+	// Open connection counts and the registered player count are part of the LAN payload
+	InvalidateLANPayload(SessionName);
+
+	if (Session->RegisteredPlayers.Num() != OldPlayerCount)
 	{
-		UE_LOG_ONLINE_SESSION(Warning, TEXT("No game present to leave for session (%s)"), *SessionName.ToString());
-		bSuccess = false;
+		PushPlayerCount(*Session);
 	}
+	return true;
+}
 
-	TriggerOnUnregisterPlayersCompleteDelegates(SessionName, Players, bSuccess);
-	return bSuccess;
+void FOnlineSessionPython::PushPlayerCount(FNamedOnlineSession& Session)
+{
+	if (!IsHost(Session))
+	{
+		return;
+	}
+
+	// Only the session registered with the master server is listed there
+	if (Session.SessionSettings.bIsLANMatch || ResolveSessionHandle(CreateSessionHandle) != &Session)
+	{
+		return;
+	}
+
+	// The first change starts the wait, later ones join it
+	if (!bPlayerCountPending)
+	{
+		bPlayerCountPending = true;
+		PlayerCountPushTimeInSeconds = FPlatformTime::Seconds() + PlayerCountPushDelaySeconds;
+	}
+}
+
+void FOnlineSessionPython::TickPlayerCountPush()
+{
+	if (!bPlayerCountPending || FPlatformTime::Seconds() < PlayerCountPushTimeInSeconds)
+	{
+		return;
+	}
+
+	FNamedOnlineSession* Session = ResolveSessionHandle(CreateSessionHandle);
+	if (Session == nullptr || Session->SessionState == EOnlineSessionState::Destroying)
+	{
+		bPlayerCountPending = false;
+		return;
+	}
+
+	// Wait for register_server to finish, and let a heartbeat that is nearly due carry the count instead of a request of its own
+	const float HeartbeatTimeRemaining = GetHeartbeatTimeRemaining();
+	if (Session->SessionState == EOnlineSessionState::Creating ||
+		(HeartbeatTimeRemaining >= 0.0f && HeartbeatTimeRemaining <= PlayerCountHeartbeatWaitSeconds) ||
+		IsBackingOffFromMasterServer())
+	{
+		return;
+	}
+
+	bPlayerCountPending = false;
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::UpdateServer, Build);
+	QueueMasterServerRequest(new FOnlineAsyncTaskPythonUpdateServer(PythonSubsystem, Session->SessionName, MakeUpdateServerQuery(*Session), false));
 }
 
 void FOnlineSessionPython::Tick(float DeltaTime)
 {
 	SCOPE_CYCLE_COUNTER(STAT_Session_Interface);
 	TickLanTasks(DeltaTime);
+	TickRegisterAwaitingLogin();
+	TickPlayerCountPush();
 }
 
 void FOnlineSessionPython::TickLanTasks(float DeltaTime)
 {
 	LANSessionManager.Tick(DeltaTime);
+	TickLANSearch();
+	TickHybridSearch();
 }
 
-void FOnlineSessionPython::AppendSessionToPacket(FNboSerializeToBufferNull& Packet, FOnlineSession* Session)
+void FOnlineSessionPython::TickLANSearch()
+{
+	if (LANSessionManager.GetBeaconState() != ELanBeaconState::Searching || !CurrentSessionSearch.IsValid())
+	{
+		return;
+	}
+
+	// Hand over everything that arrived this tick in one go
+	const int32 NumResults = CurrentSessionSearch->SearchResults.Num();
+	if (NumResults > NumLANResultsNotified)
+	{
+		const int32 FirstNewResult = NumLANResultsNotified;
+		NumLANResultsNotified = NumResults;
+		TriggerOnFindSessionsResultsUpdatedDelegates(FirstNewResult, NumResults);
+
+		// The search may have been cancelled from the delegate
+		if (!CurrentSessionSearch.IsValid())
+		{
+			return;
+		}
+	}
+
+	// Without any responses there is nothing to adapt to, so that case is left to the beacon timeout
+	const double Now = FPlatformTime::Seconds();
+	if (NumLANResponses > 0 &&
+		Now - SessionSearchStartInSeconds >= LANSearchMinSeconds &&
+		Now - LastLANResponseInSeconds >= GetLANSearchQuietWindow())
+	{
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("LAN search quiet for %.3f seconds after %d responses, finishing early"), Now - LastLANResponseInSeconds, NumLANResponses);
+		OnLANSearchTimeout();
+	}
+}
+
+void FOnlineSessionPython::RecordLANResponseArrival(bool bMoreFollows)
+{
+	const double Now = FPlatformTime::Seconds();
+	const double Gap = Now - LastLANResponseInSeconds;
+
+	// Until there is a real gap, the delay of the first response stands in for one
+	LANResponseGapInSeconds = NumLANResponses == 0 ? Gap : FMath::Lerp(LANResponseGapInSeconds, Gap, LANSearchGapSmoothing);
+	LastLANResponseInSeconds = Now;
+	NumLANResponses++;
+	bLANResponseMoreFollows = bMoreFollows;
+}
+
+double FOnlineSessionPython::GetLANSearchQuietWindow() const
+{
+	const double MaxQuietSeconds = FMath::Max((double)LANSessionManager.LanQueryTimeout, LANSearchMinQuietSeconds);
+	double QuietWindow = FMath::Clamp(LANResponseGapInSeconds * LANSearchQuietGaps, LANSearchMinQuietSeconds, MaxQuietSeconds);
+	if (bLANResponseMoreFollows)
+	{
+		// A host is part way through answering, give its next packet longer
+		QuietWindow = FMath::Min(QuietWindow * 2.0, MaxQuietSeconds);
+	}
+	return QuietWindow;
+}
+
+void FOnlineSessionPython::AppendSessionToPacket(FNboSerializeToBufferNull& Packet, FNamedOnlineSession* Session)
 {
 	/** Owner of the session */
 	Packet << *StaticCastSharedPtr<const FUniqueNetIdPython>(Session->OwningUserId)
@@ -1239,29 +1695,33 @@ void FOnlineSessionPython::AppendSessionToPacket(FNboSerializeToBufferNull& Pack
 	Packet << *StaticCastSharedPtr<FOnlineSessionInfoPython>(Session->SessionInfo);
 
 	// Now append per game settings
-	AppendSessionSettingsToPacket(Packet, &Session->SessionSettings);
+	AppendSessionSettingsToPacket(Packet, &Session->SessionSettings, Session->RegisteredPlayers.Num());
 }
 
-void FOnlineSessionPython::AppendSessionSettingsToPacket(FNboSerializeToBufferNull& Packet, FOnlineSessionSettings* SessionSettings)
+void FOnlineSessionPython::AppendSessionSettingsToPacket(FNboSerializeToBufferNull& Packet, FOnlineSessionSettings* SessionSettings, int32 RegisteredPlayerCount)
 {
 #if DEBUG_LAN_BEACON
 	UE_LOG_ONLINE_SESSION(Verbose, TEXT("Sending session settings to client"));
 #endif 
 
-	// Members of the session settings class
-	Packet << SessionSettings->NumPublicConnections
-		<< SessionSettings->NumPrivateConnections
-		<< (uint8)SessionSettings->bShouldAdvertise
-		<< (uint8)SessionSettings->bIsLANMatch
-		<< (uint8)SessionSettings->bIsDedicated
-		<< (uint8)SessionSettings->bUsesStats
-		<< (uint8)SessionSettings->bAllowJoinInProgress
-		<< (uint8)SessionSettings->bAllowInvites
-		<< (uint8)SessionSettings->bUsesPresence
-		<< (uint8)SessionSettings->bAllowJoinViaPresence
-		<< (uint8)SessionSettings->bAllowJoinViaPresenceFriendsOnly
-		<< (uint8)SessionSettings->bAntiCheatProtected
-	    << SessionSettings->BuildUniqueId;
+	Packet << (uint8)LAN_COMPACT_SETTINGS_VERSION;
+
+	// Members of the session settings class, with the flags packed into a bitfield
+	Packet.WriteVarInt(SessionSettings->NumPublicConnections);
+	Packet.WriteVarInt(SessionSettings->NumPrivateConnections);
+	const uint16 Flags =
+		(SessionSettings->bShouldAdvertise ? 1 << 0 : 0) |
+		(SessionSettings->bIsLANMatch ? 1 << 1 : 0) |
+		(SessionSettings->bIsDedicated ? 1 << 2 : 0) |
+		(SessionSettings->bUsesStats ? 1 << 3 : 0) |
+		(SessionSettings->bAllowJoinInProgress ? 1 << 4 : 0) |
+		(SessionSettings->bAllowInvites ? 1 << 5 : 0) |
+		(SessionSettings->bUsesPresence ? 1 << 6 : 0) |
+		(SessionSettings->bAllowJoinViaPresence ? 1 << 7 : 0) |
+		(SessionSettings->bAllowJoinViaPresenceFriendsOnly ? 1 << 8 : 0) |
+		(SessionSettings->bAntiCheatProtected ? 1 << 9 : 0);
+	Packet.WriteUInt16(Flags);
+	Packet.WriteVarInt(SessionSettings->BuildUniqueId);
 
 	// First count number of advertised keys
 	int32 NumAdvertisedProperties = 0;
@@ -1273,81 +1733,300 @@ void FOnlineSessionPython::AppendSessionSettingsToPacket(FNboSerializeToBufferNu
 			NumAdvertisedProperties++;
 		}
 	}
+	static const FName PlayerCountKey(TEXT("PLAYERCOUNT"));
+	const bool bAppendPlayerCount = RegisteredPlayerCount != INDEX_NONE && SessionSettings->Settings.Find(PlayerCountKey) == nullptr;
+	if (bAppendPlayerCount)
+	{
+		NumAdvertisedProperties++;
+	}
 
-	// Add count of advertised keys and the data
-	Packet << (int32)NumAdvertisedProperties;
+	// Add count of advertised keys and the data, well known keys are sent as their dictionary id + 1 and anything else as 0 followed by the name
+	const TArray<FName>& KeyDictionary = GetLANSettingsKeyDictionary();
+	Packet.WriteVarUInt(NumAdvertisedProperties);
 	for (FSessionSettings::TConstIterator It(SessionSettings->Settings); It; ++It)
 	{
 		const FOnlineSessionSetting& Setting = It.Value();
 		if (Setting.AdvertisementType >= EOnlineDataAdvertisementType::ViaOnlineService)
 		{
-			Packet << It.Key();
-			Packet << Setting;
+			const int32 KeyId = KeyDictionary.IndexOfByKey(It.Key());
+			Packet.WriteVarUInt(KeyId + 1);
+			if (KeyId == INDEX_NONE)
+			{
+				Packet.WriteCompactString(It.Key().ToString());
+			}
+			Packet.WriteCompactSetting(Setting);
 #if DEBUG_LAN_BEACON
 			UE_LOG_ONLINE_SESSION(Verbose, TEXT("%s"), *Setting.ToString());
 #endif
 		}
 	}
+	if (bAppendPlayerCount)
+	{
+		Packet.WriteVarUInt(KeyDictionary.IndexOfByKey(PlayerCountKey) + 1);
+		Packet.WriteCompactSetting(FOnlineSessionSetting(RegisteredPlayerCount, EOnlineDataAdvertisementType::ViaOnlineService));
+	}
 }
 
-void FOnlineSessionPython::OnValidQueryPacketReceived(uint8* PacketData, int32 PacketLength, uint64 ClientNonce)
+TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> FOnlineSessionPython::GetLANPayload(FNamedOnlineSession& Session)
 {
-	// Iterate through all registered sessions and respond for each one that can be joinable
-	FScopeLock ScopeLock(&SessionLock);
-	for (int32 SessionIndex = 0; SessionIndex < Sessions.Num(); SessionIndex++)
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>* CachedPayload = LANPayloads.Find(Session.SessionName);
+	if (CachedPayload)
 	{
-		FNamedOnlineSession* Session = &Sessions[SessionIndex];
+		return *CachedPayload;
+	}
 
-		// Don't respond to query if the session is not a joinable LAN match.
-		if (Session && IsSessionJoinable(*Session))
-		{
-			FNboSerializeToBufferNull Packet(LAN_BEACON_MAX_PACKET_SIZE);
-			// Create the basic header before appending additional information
-			LANSessionManager.CreateHostResponsePacket(Packet, ClientNonce);
+	FNboSerializeToBufferNull Payload(LAN_BEACON_MAX_PACKET_SIZE);
+	AppendSessionToPacket(Payload, &Session);
+	if (Payload.HasOverflow())
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("LAN broadcast packet overflow, cannot broadcast on LAN"));
+		return nullptr;
+	}
+
+	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> NewPayload = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+	NewPayload->Append(Payload.GetRawBuffer(0), Payload.GetByteCount());
+
+	// The net driver may not be listening yet, keep re-serializing until the advertised port is real
+	TSharedPtr<FOnlineSessionInfoPython> SessionInfo = StaticCastSharedPtr<FOnlineSessionInfoPython>(Session.SessionInfo);
+	if (SessionInfo.IsValid() && SessionInfo->HostAddr.IsValid() && SessionInfo->HostAddr->GetPort() != 0)
+	{
+		LANPayloads.Add(Session.SessionName, NewPayload);
+	}
+	return NewPayload;
+}
+
+void FOnlineSessionPython::InvalidateLANPayload(FName SessionName)
+{
+	FScopeLock ScopeLock(&SessionLock);
+	LANPayloads.Remove(SessionName);
+}
 
-			// Add all the session details
-			AppendSessionToPacket(Packet, Session);
+void FOnlineSessionPython::OnValidQueryPacketReceived(uint8* PacketData, int32 PacketLength, uint64 ClientNonce)
+{
+	// Gather the payloads of every joinable session, only serializing the ones that changed since the last query
+	TArray<TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>, TInlineAllocator<4>> Payloads;
+	{
+		FScopeLock ScopeLock(&SessionLock);
+		for (int32 SessionIndex = 0; SessionIndex < Sessions.Num(); SessionIndex++)
+		{
+			FNamedOnlineSession& Session = Sessions[SessionIndex];
 
-			// Broadcast this response so the client can see us
-			if (!Packet.HasOverflow())
+			// Don't respond to query if the session is not a joinable LAN match.
+			if (IsSessionJoinable(Session))
 			{
-				LANSessionManager.BroadcastPacket(Packet, Packet.GetByteCount());
+				TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> Payload = GetLANPayload(Session);
+				if (Payload.IsValid())
+				{
+					Payloads.Add(Payload);
+				}
 			}
-			else
+		}
+	}
+
+	// Respond outside the lock, packing as many session records into each datagram as fit
+	int32 PayloadIndex = 0;
+	while (PayloadIndex < Payloads.Num())
+	{
+		FNboSerializeToBufferNull Packet(LAN_BEACON_MAX_PACKET_SIZE);
+		// Create the basic header before appending additional information
+		LANSessionManager.CreateHostResponsePacket(Packet, ClientNonce);
+
+		// Work out how many records fit first, the flags have to say whether more packets follow
+		const int32 SpaceForRecords = LAN_BEACON_MAX_PACKET_SIZE - (int32)Packet.GetByteCount() - LAN_PACKED_RESPONSE_HEADER_SIZE;
+		int32 NumRecords = 0;
+		int32 RecordBytes = 0;
+		while (PayloadIndex + NumRecords < Payloads.Num() && NumRecords < MAX_uint16)
+		{
+			const int32 RecordSize = LAN_PACKED_RECORD_HEADER_SIZE + Payloads[PayloadIndex + NumRecords]->Num();
+			if (RecordBytes + RecordSize > SpaceForRecords)
 			{
-				UE_LOG_ONLINE_SESSION(Warning, TEXT("LAN broadcast packet overflow, cannot broadcast on LAN"));
+				break;
 			}
+			RecordBytes += RecordSize;
+			NumRecords++;
+		}
+
+		if (NumRecords == 0)
+		{
+			// This session doesn't fit in a datagram even on its own
+			UE_LOG_ONLINE_SESSION(Warning, TEXT("LAN broadcast packet overflow, cannot broadcast on LAN"));
+			PayloadIndex++;
+			continue;
+		}
+
+		const bool bMoreFollow = PayloadIndex + NumRecords < Payloads.Num();
+		Packet << (uint32)LAN_PACKED_RESPONSE_MAGIC
+			<< (uint8)LAN_PACKED_RESPONSE_VERSION
+			<< (uint8)(bMoreFollow ? LAN_PACKED_RESPONSE_MORE_FOLLOWS : 0);
+		Packet.WriteUInt16((uint16)NumRecords);
+		for (int32 RecordIndex = PayloadIndex; RecordIndex < PayloadIndex + NumRecords; RecordIndex++)
+		{
+			const TArray<uint8>& Payload = *Payloads[RecordIndex];
+			Packet.WriteUInt16((uint16)Payload.Num());
+			Packet.WriteBinary(Payload.GetData(), Payload.Num());
+		}
+		PayloadIndex += NumRecords;
+
+		// Broadcast this response so the client can see us
+		if (!Packet.HasOverflow())
+		{
+			LANSessionManager.BroadcastPacket(Packet, Packet.GetByteCount());
+		}
+		else
+		{
+			UE_LOG_ONLINE_SESSION(Warning, TEXT("LAN broadcast packet overflow, cannot broadcast on LAN"));
 		}
 	}
 }
 
-void FOnlineSessionPython::ReadSessionFromPacket(FNboSerializeFromBufferNull& Packet, FOnlineSession* Session)
+void FOnlineSessionPython::ReadSessionFromPacket(FNboSerializeFromBufferNull& Packet, FOnlineSession* Session, bool bCompactSettings)
 {
 #if DEBUG_LAN_BEACON
 	UE_LOG_ONLINE_SESSION(Verbose, TEXT("Reading session information from server"));
 #endif
 
-	/** Owner of the session */
-	FUniqueNetIdPython* UniqueId = new FUniqueNetIdPython;
-	Packet >> *UniqueId
+	// Too short to hold even empty strings and settings, don't decode any of it
+	const int32 MinRecordSize = LAN_MIN_SESSION_HEADER_SIZE + (bCompactSettings ? LAN_MIN_COMPACT_SETTINGS_SIZE : LAN_MIN_LEGACY_SETTINGS_SIZE);
+	if (Packet.GetBytesRemaining() < MinRecordSize)
+	{
+		Packet.MarkMalformed();
+		return;
+	}
+
+	// Everything is read into locals first, the owner id and session info are only allocated once the whole record has decoded.
+	// String lengths are checked against the packet by the serializer before any string is allocated.
+	FString OwnerId;
+	FString SessionId;
+	Packet >> OwnerId
 		>> Session->OwningUserName
 		>> Session->NumOpenPrivateConnections
-		>> Session->NumOpenPublicConnections;
-
-	Session->OwningUserId = MakeShareable(UniqueId);
+		>> Session->NumOpenPublicConnections
+		>> SessionId;
+	if (Packet.HasOverflow())
+	{
+		return;
+	}
 
-	// Allocate and read the connection data
-	FOnlineSessionInfoPython* NullSessionInfo = new FOnlineSessionInfoPython();
-	NullSessionInfo->HostAddr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
-	Packet >> *NullSessionInfo;
-	Session->SessionInfo = MakeShareable(NullSessionInfo); 
+	if (!LANResponseHostAddr.IsValid())
+	{
+		LANResponseHostAddr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+	}
+	Packet >> *LANResponseHostAddr;
 
 	// Read any per object data using the server object
-	ReadSettingsFromPacket(Packet, Session->SessionSettings);
+	if (bCompactSettings)
+	{
+		ReadSettingsFromPacket(Packet, Session->SessionSettings);
+	}
+	else
+	{
+		ReadLegacySettingsFromPacket(Packet, Session->SessionSettings);
+	}
+
+	if (Packet.HasOverflow())
+	{
+		return;
+	}
+
+	/** Owner of the session */
+	Session->OwningUserId = MakeShareable(new FUniqueNetIdPython(OwnerId));
+
+	// Allocate the connection data
+	FOnlineSessionInfoPython* NullSessionInfo = new FOnlineSessionInfoPython();
+	NullSessionInfo->SessionId = FUniqueNetIdPython(SessionId);
+	NullSessionInfo->HostAddr = LANResponseHostAddr->Clone();
+	Session->SessionInfo = MakeShareable(NullSessionInfo);
 }
 
 void FOnlineSessionPython::ReadSettingsFromPacket(FNboSerializeFromBufferNull& Packet, FOnlineSessionSettings& SessionSettings)
 {
+#if DEBUG_LAN_BEACON
+	UE_LOG_ONLINE_SESSION(Verbose, TEXT("Reading compact game settings from server"));
+#endif
+
+	// Clear out any old settings
+	SessionSettings.Settings.Empty();
+
+	uint8 Version = 0;
+	Packet >> Version;
+	if (Version != LAN_COMPACT_SETTINGS_VERSION)
+	{
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Unsupported compact settings version %d in ReadSettingsFromPacket()"), Version);
+		Packet.MarkMalformed();
+		return;
+	}
+
+	// Members of the session settings class
+	Packet.ReadVarInt32(SessionSettings.NumPublicConnections);
+	Packet.ReadVarInt32(SessionSettings.NumPrivateConnections);
+	uint16 Flags = 0;
+	Packet.ReadUInt16(Flags);
+	SessionSettings.bShouldAdvertise = (Flags & (1 << 0)) != 0;
+	SessionSettings.bIsLANMatch = (Flags & (1 << 1)) != 0;
+	SessionSettings.bIsDedicated = (Flags & (1 << 2)) != 0;
+	SessionSettings.bUsesStats = (Flags & (1 << 3)) != 0;
+	SessionSettings.bAllowJoinInProgress = (Flags & (1 << 4)) != 0;
+	SessionSettings.bAllowInvites = (Flags & (1 << 5)) != 0;
+	SessionSettings.bUsesPresence = (Flags & (1 << 6)) != 0;
+	SessionSettings.bAllowJoinViaPresence = (Flags & (1 << 7)) != 0;
+	SessionSettings.bAllowJoinViaPresenceFriendsOnly = (Flags & (1 << 8)) != 0;
+	SessionSettings.bAntiCheatProtected = (Flags & (1 << 9)) != 0;
+	Packet.ReadVarInt32(SessionSettings.BuildUniqueId);
+
+	// Every setting takes at least a key id and a type byte, so a count the rest of the packet can't hold is malformed
+	uint64 NumAdvertisedProperties = 0;
+	Packet.ReadVarUInt(NumAdvertisedProperties);
+	if (NumAdvertisedProperties > (uint64)Packet.GetBytesRemaining() / 2)
+	{
+		Packet.MarkMalformed();
+	}
+
+	const TArray<FName>& KeyDictionary = GetLANSettingsKeyDictionary();
+	for (uint64 Index = 0; Index < NumAdvertisedProperties && !Packet.HasOverflow(); Index++)
+	{
+		uint64 KeyId = 0;
+		Packet.ReadVarUInt(KeyId);
+
+		FName Key;
+		if (KeyId == 0)
+		{
+			FString KeyName;
+			Packet.ReadCompactString(KeyName);
+			Key = FName(*KeyName);
+		}
+		else if (KeyId <= (uint64)KeyDictionary.Num())
+		{
+			Key = KeyDictionary[KeyId - 1];
+		}
+		else
+		{
+			// A key id from a newer dictionary, the rest of the settings can't be located reliably
+			Packet.MarkMalformed();
+			break;
+		}
+
+		FOnlineSessionSetting Setting;
+		Packet.ReadCompactSetting(Setting);
+		if (!Packet.HasOverflow())
+		{
+			SessionSettings.Set(Key, Setting);
+		}
+
+#if DEBUG_LAN_BEACON
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("%s"), *Setting.ToString());
+#endif
+	}
+
+	// If there was an overflow, treat the string settings/properties as broken
+	if (Packet.HasOverflow())
+	{
+		SessionSettings.Settings.Empty();
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Packet overflow detected in ReadSettingsFromPacket()"));
+	}
+}
+
+void FOnlineSessionPython::ReadLegacySettingsFromPacket(FNboSerializeFromBufferNull& Packet, FOnlineSessionSettings& SessionSettings)
+{
 #if DEBUG_LAN_BEACON
 	UE_LOG_ONLINE_SESSION(Verbose, TEXT("Reading game settings from server"));
 #endif
@@ -1388,6 +2067,11 @@ void FOnlineSessionPython::ReadSettingsFromPacket(FNboSerializeFromBufferNull& P
 	int32 NumAdvertisedProperties = 0;
 	// First, read the number of advertised properties involved, so we can presize the array
 	Packet >> NumAdvertisedProperties;
+	// Every setting takes at least a key length and a type byte, so a count the rest of the packet can't hold is malformed
+	if (NumAdvertisedProperties < 0 || NumAdvertisedProperties > Packet.GetBytesRemaining() / 5)
+	{
+		Packet.MarkMalformed();
+	}
 	if (Packet.HasOverflow() == false)
 	{
 		FName Key;
@@ -1417,27 +2101,94 @@ void FOnlineSessionPython::ReadSettingsFromPacket(FNboSerializeFromBufferNull& P
 
 void FOnlineSessionPython::OnValidResponsePacketReceived(uint8* PacketData, int32 PacketLength)
 {
-	// Create an object that we'll copy the data to
-	FOnlineSessionSettings NewServer;
-	if (CurrentSessionSearch.IsValid())
+	if (!CurrentSessionSearch.IsValid())
 	{
-		// Add space in the search results array
-		FOnlineSessionSearchResult* NewResult = new (CurrentSessionSearch->SearchResults) FOnlineSessionSearchResult();
-		// this is not a correct ping, but better than nothing
-		NewResult->PingInMs = static_cast<int32>((FPlatformTime::Seconds() - SessionSearchStartInSeconds) * 1000);
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Failed to create new online game settings object"));
+		return;
+	}
 
-		FOnlineSession* NewSession = &NewResult->Session;
+	// No host sends more than a beacon packet, anything larger didn't come from one
+	if (PacketLength <= 0 || PacketLength > LAN_BEACON_MAX_PACKET_SIZE)
+	{
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Ignoring LAN response of %d bytes"), PacketLength);
+		return;
+	}
 
-		// Prepare to read data from the packet
-		FNboSerializeFromBufferNull Packet(PacketData, PacketLength);
-		
-		ReadSessionFromPacket(Packet, NewSession);
+	// Prepare to read data from the packet
+	FNboSerializeFromBufferNull Packet(PacketData, PacketLength);
+	uint32 Magic = 0;
+	if (PacketLength >= LAN_PACKED_RESPONSE_HEADER_SIZE)
+	{
+		Packet >> Magic;
+	}
 
-		// NOTE: we don't notify until the timeout happens
+	if (Magic != LAN_PACKED_RESPONSE_MAGIC)
+	{
+		// A host that answers with one session per packet, using the fixed width settings layout
+		RecordLANResponseArrival(false);
+		AddSearchResultFromPacket(PacketData, PacketLength, false);
+		return;
 	}
-	else
+
+	uint8 Version = 0;
+	uint8 Flags = 0;
+	uint16 NumRecords = 0;
+	Packet >> Version >> Flags;
+	Packet.ReadUInt16(NumRecords);
+	if (Version != LAN_PACKED_RESPONSE_VERSION)
 	{
-		UE_LOG_ONLINE_SESSION(Warning, TEXT("Failed to create new online game settings object"));
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Ignoring LAN response with unsupported packed version %d"), Version);
+		return;
+	}
+
+	// Walk the record lengths before decoding anything, a response whose framing doesn't add up is dropped as a whole
+	{
+		FNboSerializeFromBufferNull Framing(PacketData, PacketLength);
+		Framing.SkipBytes(LAN_PACKED_RESPONSE_HEADER_SIZE);
+		if ((int32)NumRecords * LAN_PACKED_RECORD_HEADER_SIZE > Framing.GetBytesRemaining())
+		{
+			Framing.MarkMalformed();
+		}
+		for (int32 RecordIndex = 0; RecordIndex < NumRecords && !Framing.HasOverflow(); RecordIndex++)
+		{
+			uint16 RecordLength = 0;
+			Framing.ReadUInt16(RecordLength);
+			Framing.SkipBytes(RecordLength);
+		}
+		if (Framing.HasOverflow())
+		{
+			UE_LOG_ONLINE_SESSION(Verbose, TEXT("Ignoring truncated packed LAN response claiming %d records"), NumRecords);
+			return;
+		}
+	}
+
+	RecordLANResponseArrival((Flags & LAN_PACKED_RESPONSE_MORE_FOLLOWS) != 0);
+
+	for (int32 RecordIndex = 0; RecordIndex < NumRecords; RecordIndex++)
+	{
+		uint16 RecordLength = 0;
+		Packet.ReadUInt16(RecordLength);
+		// Records are decoded in place
+		const uint8* Record = Packet.SkipBytes(RecordLength);
+		AddSearchResultFromPacket(const_cast<uint8*>(Record), RecordLength, true);
+	}
+
+	// NOTE: results are passed on from TickLANSearch, the search completes once responses go quiet or the timeout happens
+}
+
+void FOnlineSessionPython::AddSearchResultFromPacket(uint8* RecordData, int32 RecordLength, bool bCompactSettings)
+{
+	FOnlineSessionSearchResult NewResult;
+	// this is not a correct ping, but better than nothing
+	NewResult.PingInMs = static_cast<int32>((FPlatformTime::Seconds() - SessionSearchStartInSeconds) * 1000);
+
+	FNboSerializeFromBufferNull Packet(RecordData, RecordLength);
+	ReadSessionFromPacket(Packet, &NewResult.Session, bCompactSettings);
+
+	// Don't hand broken sessions to the game
+	if (!Packet.HasOverflow())
+	{
+		AddSearchResult(MoveTemp(NewResult), true);
 	}
 }
 
@@ -1455,6 +2206,14 @@ void FOnlineSessionPython::OnLANSearchTimeout()
 {
 	FinalizeLANSearch();
 
+	if (bHybridSearch)
+	{
+		// The master server half may still be running
+		bHybridLANPending = false;
+		TryCompleteHybridSearch();
+		return;
+	}
+
 	if (CurrentSessionSearch.IsValid())
 	{
 		if (CurrentSessionSearch->SearchResults.Num() > 0)
@@ -1500,20 +2259,75 @@ void FOnlineSessionPython::StartHeartbeat(float DeltaBetweenHeartbeats)
 #endif
 }
 
+void FOnlineSessionPython::StopHeartbeat()
+{
+#if WITH_ENGINE
+	if (GEngine)
+	{
+		const FOnlineSubsystemPython& Subsystem = *PythonSubsystem;
+		UWorld* World = GetWorldForOnline(Subsystem.GetInstanceName());
+		if (World)
+		{
+			World->GetTimerManager().ClearTimer(PerformHeartbeat_Handle);
+		}
+	}
+#endif
+}
+
+float FOnlineSessionPython::GetHeartbeatTimeRemaining() const
+{
+#if WITH_ENGINE
+	if (GEngine)
+	{
+		const FOnlineSubsystemPython& Subsystem = *PythonSubsystem;
+		UWorld* World = GetWorldForOnline(Subsystem.GetInstanceName());
+		if (World)
+		{
+			return World->GetTimerManager().GetTimerRemaining(PerformHeartbeat_Handle);
+		}
+	}
+#endif
+	return -1.0f;
+}
+
 void FOnlineSessionPython::PerformHeartbeat()
 {
-	FHttpModule* Http = &FHttpModule::Get();
-	TSharedRef<IHttpRequest, ESPMode::ThreadSafe> Request = Http->CreateRequest();
-	Request->SetHeader(TEXT("User-Agent"), TEXT("X-UnrealEngine-Agent"));
-	Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
-	Request->SetVerb("GET");
-	FNamedOnlineSession* Session = GetNamedSession(CreateSessionName);
+	if (IsBackingOffFromMasterServer())
+	{
+		// Skip this beat, the next one is still well inside the master server's expiry window
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Skipping heartbeat, the master server asked us to back off"));
+		return;
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(PythonSubsystem->GetRequestStats(), EPythonRequest::Heartbeat, Build);
+	FNamedOnlineSession* Session = ResolveSessionHandle(CreateSessionHandle);
+	if (Session == nullptr)
+	{
+		// The session was destroyed, stop advertising it rather than heartbeat whatever now has its name
+		StopHeartbeat();
+		return;
+	}
 	FOnlineSessionInfoPython* SessionInfo = (FOnlineSessionInfoPython*)Session->SessionInfo.Get();
 	SetPortFromNetDriver(*PythonSubsystem, Session->SessionInfo);
-	UOnlineSubsystemPythonConfig* config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
-	
-	Request->SetURL(FString::Printf(TEXT("http://%s/perform_heartbeat?port=%d"), *config->ServerAddress, SessionInfo->HostAddr->GetPort()));
-	Request->ProcessRequest();
+
+	FString Query = FString::Printf(TEXT("?id=%s&port=%d"), *SessionInfo->SessionId.ToString(), SessionInfo->HostAddr->GetPort());
+	if (bPlayerCountPending)
+	{
+		// Carry the pending player count and players rather than send them on their own
+		Query += FString::Printf(TEXT("&playercount=%d&players=%s"), GetAdvertisedPlayerCount(*Session), *MakePlayersQueryValue(*Session));
+		bPlayerCountPending = false;
+	}
+	QueueMasterServerRequest(new FOnlineAsyncTaskPythonHeartbeat(PythonSubsystem, CreateSessionHandle, Query));
+}
+
+void FOnlineSessionPython::QueueMasterServerRequest(FOnlineAsyncTaskPythonMasterServer* Task)
+{
+	PythonSubsystem->QueueAsyncParallelTask(Task);
+}
+
+bool FOnlineSessionPython::IsBackingOffFromMasterServer() const
+{
+	return FPlatformTime::Seconds() < MasterServerBackoffEndTime;
 }
 
 void FOnlineSessionPython::RegisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate)
@@ -19,9 +19,49 @@ Permission is granted to anyone to use this software for any purpose, including
 #include "OnlineIdentityPython.h"
 #include "VoiceInterfacePython.h"
 #include "OnlineAsyncTaskManagerPython.h"
+#include "OnlineRequestStatsPython.h"
 
 FThreadSafeCounter FOnlineSubsystemPython::TaskCounter;
 
+FOnlineRequestStatsPython& FOnlineSubsystemPython::GetRequestStats() const
+{
+	check(RequestStats.IsValid());
+	return *RequestStats;
+}
+
+void FOnlineSubsystemPython::QueueAsyncParallelTask(FOnlineAsyncTask* AsyncTask)
+{
+	check(OnlineAsyncTaskThreadRunnable);
+	OnlineAsyncTaskThreadRunnable->AddToParallelTasks(AsyncTask);
+}
+
+bool FOnlineSubsystemPython::UpdateSessionPlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Joining, const TArray< TSharedRef<const FUniqueNetId> >& Leaving, bool bWasInvited)
+{
+	return SessionInterface.IsValid() && SessionInterface->UpdatePlayers(SessionName, Joining, Leaving, bWasInvited);
+}
+
+bool FOnlineSubsystemPython::FindGroupSession(int32 LocalUserNum, const TArray< TSharedRef<const FUniqueNetId> >& GroupMembers, const FOnlineSessionSearch& SearchSettings, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate)
+{
+	if (!SessionInterface.IsValid())
+	{
+		FOnlineSessionSearchResult EmptyResult;
+		CompletionDelegate.ExecuteIfBound(LocalUserNum, false, EmptyResult);
+		return false;
+	}
+	return SessionInterface->FindGroupSession(LocalUserNum, GroupMembers, &SearchSettings, nullptr, CompletionDelegate);
+}
+
+bool FOnlineSubsystemPython::ReserveGroupSession(int32 LocalUserNum, const TArray< TSharedRef<const FUniqueNetId> >& GroupMembers, const FOnlineSessionSearchResult& DesiredSession, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate)
+{
+	if (!SessionInterface.IsValid())
+	{
+		FOnlineSessionSearchResult EmptyResult;
+		CompletionDelegate.ExecuteIfBound(LocalUserNum, false, EmptyResult);
+		return false;
+	}
+	return SessionInterface->FindGroupSession(LocalUserNum, GroupMembers, nullptr, &DesiredSession, CompletionDelegate);
+}
+
 IOnlineSessionPtr FOnlineSubsystemPython::GetSessionInterface() const
 {
 	return SessionInterface;
@@ -179,6 +219,11 @@ bool FOnlineSubsystemPython::Tick(float DeltaTime)
 		SessionInterface->Tick(DeltaTime);
 	}
 
+	if (IdentityInterface.IsValid())
+	{
+		IdentityInterface->Tick(DeltaTime);
+	}
+
 	if (VoiceInterface.IsValid() && bVoiceInterfaceInitialized)
 	{
 		VoiceInterface->Tick(DeltaTime);
@@ -200,6 +245,7 @@ bool FOnlineSubsystemPython::Init()
 		check(OnlineAsyncTaskThread);
 		UE_LOG_ONLINE(Verbose, TEXT("Created thread (ID:%d)."), OnlineAsyncTaskThread->GetThreadID());
 
+		RequestStats = MakeShareable(new FOnlineRequestStatsPython());
 		SessionInterface = MakeShareable(new FOnlineSessionPython(this));
 		IdentityInterface = MakeShareable(new FOnlineIdentityPython(this));
 		VoiceInterface = MakeShareable(new FOnlineVoiceImpl(this));
@@ -251,6 +297,7 @@ bool FOnlineSubsystemPython::Shutdown()
 	DESTRUCT_INTERFACE(IdentityInterface);
 	DESTRUCT_INTERFACE(LeaderboardsInterface);
 	DESTRUCT_INTERFACE(SessionInterface);
+	DESTRUCT_INTERFACE(RequestStats);
 	
 #undef DESTRUCT_INTERFACE
 	
@@ -268,8 +315,24 @@ bool FOnlineSubsystemPython::Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevi
 	{
 		return true;
 	}
-	return false;
+
+	bool bWasHandled = false;
+	if (FParse::Command(&Cmd, TEXT("MASTERSERVER")))
+	{
+		if (FParse::Command(&Cmd, TEXT("STATS")))
+		{
+			GetRequestStats().Dump(Ar);
+			bWasHandled = true;
+		}
+		else if (FParse::Command(&Cmd, TEXT("RESETSTATS")))
+		{
+			GetRequestStats().Reset();
+			bWasHandled = true;
+		}
+	}
+	return bWasHandled;
 }
+
 FText FOnlineSubsystemPython::GetOnlineServiceName() const
 {
 	return NSLOCTEXT("OnlineSubsystemPython", "OnlineServiceName", "Python");
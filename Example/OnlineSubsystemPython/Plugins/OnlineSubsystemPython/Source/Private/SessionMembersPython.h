@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/CoreOnline.h"
+#include "OnlineSubsystemPythonTypes.h"
+
+class FNamedOnlineSession;
+
+/**
+ * Hash set key for a player id. Python ids use the hash they were made with, other ids are hashed over the bytes FUniqueNetId compares.
+ * Keys stored in the index keep their id alive, keys made to look a player up only point at it.
+ */
+struct FSessionMemberKeyPython
+{
+	/** Keeps Id alive while the key is in the index, unset for lookup keys */
+	TSharedPtr<const FUniqueNetId> Owner;
+
+	/** The player id */
+	const FUniqueNetId* Id;
+
+	/** Hash of the id, from HashId */
+	uint32 Hash;
+
+	/** Makes a key to look a player up, valid as long as InId is */
+	explicit FSessionMemberKeyPython(const FUniqueNetId& InId) :
+		Id(&InId),
+		Hash(HashId(InId))
+	{}
+
+	/** Makes a key to store in the index */
+	explicit FSessionMemberKeyPython(const TSharedRef<const FUniqueNetId>& InId) :
+		Owner(InId),
+		Id(&InId.Get()),
+		Hash(HashId(*InId))
+	{}
+
+	bool operator==(const FSessionMemberKeyPython& Other) const
+	{
+		return Hash == Other.Hash && *Id == *Other.Id;
+	}
+
+	friend uint32 GetTypeHash(const FSessionMemberKeyPython& Key)
+	{
+		return Key.Hash;
+	}
+
+	/** @return hash of an id, the same for equal ids */
+	static uint32 HashId(const FUniqueNetId& Id)
+	{
+		if (Id.GetType() == FUniqueNetIdPython::GetTypeName())
+		{
+			return static_cast<const FUniqueNetIdPython&>(Id).GetHash();
+		}
+		return FCrc::MemCrc32(Id.GetBytes(), Id.GetSize());
+	}
+};
+
+/**
+ * Hashed membership of a session, mapping each registered player to its index in the session's RegisteredPlayers.
+ *
+ * RegisteredPlayers stays the list the engine reads, this only replaces the linear FUniqueNetIdMatcher scans over it.
+ * Players should be added and removed through the index so both stay in step. If the player count no longer matches,
+ * RegisteredPlayers was changed elsewhere and the index is rebuilt from it.
+ *
+ * Not thread safe, players are registered on the game thread.
+ */
+class FSessionMembersPython
+{
+public:
+
+	/**
+	 * Finds a registered player
+	 *
+	 * @param Session the session the index is for
+	 * @param PlayerId the player to find
+	 *
+	 * @return index of the player in the session's RegisteredPlayers, INDEX_NONE if they aren't registered
+	 */
+	int32 Find(const FNamedOnlineSession& Session, const FUniqueNetId& PlayerId);
+
+	/**
+	 * Registers a player that isn't registered yet
+	 *
+	 * @param Session the session the index is for
+	 * @param PlayerId the player to add, kept by RegisteredPlayers
+	 */
+	void Add(FNamedOnlineSession& Session, const TSharedRef<const FUniqueNetId>& PlayerId);
+
+	/**
+	 * Unregisters a player. The last registered player takes their place in RegisteredPlayers
+	 *
+	 * @param Session the session the index is for
+	 * @param PlayerIndex index of the player in RegisteredPlayers, as returned by Find
+	 */
+	void RemoveAtSwap(FNamedOnlineSession& Session, int32 PlayerIndex);
+
+private:
+
+	/** Rebuilds the index if RegisteredPlayers was changed without it */
+	void Sync(const FNamedOnlineSession& Session);
+
+	/** Index in RegisteredPlayers of every registered player */
+	TMap<FSessionMemberKeyPython, int32> PlayerIndices;
+};
@@ -16,6 +16,7 @@ Permission is granted to anyone to use this software for any purpose, including
 
 #include "CoreMinimal.h"
 #include "OnlineSubsystemImpl.h"
+#include "Interfaces/OnlineSessionInterface.h"
 #include "OnlineSubsystemPythonPackage.h"
 #include "HAL/ThreadSafeCounter.h"
 
@@ -37,6 +38,13 @@ typedef TSharedPtr<class FOnlineIdentityPython, ESPMode::ThreadSafe> FOnlineIden
 typedef TSharedPtr<class FOnlineAchievementsNull, ESPMode::ThreadSafe> FOnlineAchievementsNullPtr;
 typedef TSharedPtr<class FOnlineStoreV2Null, ESPMode::ThreadSafe> FOnlineStoreV2NullPtr;
 typedef TSharedPtr<class FOnlinePurchaseNull, ESPMode::ThreadSafe> FOnlinePurchaseNullPtr;
+typedef TSharedPtr<class FOnlineRequestStatsPython, ESPMode::ThreadSafe> FOnlineRequestStatsPythonPtr;
+
+/**
+ * Search query setting (bool) asking FindSessions to search LAN and the master server at the same time, whatever bIsLanQuery is set to.
+ * Results are merged so a host found both ways appears once, with its LAN ping.
+ */
+#define SEARCH_PYTHON_LAN_AND_INTERNET FName(TEXT("PYTHONLANANDINTERNET"))
 
 /**
  *	OnlineSubsystemPython - Implementation of the online subsystem for Python services
@@ -90,6 +98,47 @@ public:
 
 	// FOnlineSubsystemPython
 
+	/**
+	 * Registers and unregisters players of a session in one pass, for servers with a lot of players joining and leaving.
+	 * Fires the same delegates as UnregisterPlayers and RegisterPlayers. A hosted internet session's new player count is
+	 * sent to the master server once for the whole call, together with any other changes made shortly after.
+	 *
+	 * @param SessionName name of the session
+	 * @param Joining players to register
+	 * @param Leaving players to unregister, removed before Joining is added
+	 * @param bWasInvited whether the joining players were invited
+	 *
+	 * @return true if the session exists
+	 */
+	bool UpdateSessionPlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Joining, const TArray< TSharedRef<const FUniqueNetId> >& Leaving, bool bWasInvited = false);
+
+	/**
+	 * Finds a server with a free slot for every member of a group, in one master server request, and holds the asking user's
+	 * slot. Hand the result to the other members, each of them then joins it with JoinSession as usual, which holds their own
+	 * slot, so join straight away. Safe to call from Advanced Sessions style callback proxies.
+	 *
+	 * @param LocalUserNum the user asking, passed back to the delegate
+	 * @param GroupMembers everyone in the group, including local user 0 whose login the request is made with. At most 16
+	 * @param SearchSettings the game mode must match, the same map and REGION are preferred as with StartMatchmaking
+	 * @param CompletionDelegate fired with the server the group fits on
+	 *
+	 * @return true if the request was sent, otherwise the delegate has already fired
+	 */
+	bool FindGroupSession(int32 LocalUserNum, const TArray< TSharedRef<const FUniqueNetId> >& GroupMembers, const FOnlineSessionSearch& SearchSettings, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate);
+
+	/**
+	 * Checks a server picked from the list has a free slot for every member of a group and holds the asking user's, in one
+	 * master server request. The other members hold their own slots as they join with JoinSession
+	 *
+	 * @param LocalUserNum the user asking, passed back to the delegate
+	 * @param GroupMembers everyone in the group, including local user 0 whose login the request is made with. At most 16
+	 * @param DesiredSession the server to hold the slots on
+	 * @param CompletionDelegate fired with the server, unsuccessfully if it hasn't room for the whole group
+	 *
+	 * @return true if the request was sent, otherwise the delegate has already fired
+	 */
+	bool ReserveGroupSession(int32 LocalUserNum, const TArray< TSharedRef<const FUniqueNetId> >& GroupMembers, const FOnlineSessionSearchResult& DesiredSession, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate);
+
 PACKAGE_SCOPE:
 
 	/** Only the factory makes instances */
@@ -107,6 +156,16 @@ PACKAGE_SCOPE:
 		OnlineAsyncTaskThread(nullptr)
 	{}
 
+	/** @return timings of recent master server requests */
+	FOnlineRequestStatsPython& GetRequestStats() const;
+
+	/**
+	 * Adds a task to the online thread that runs alongside the queued tasks rather than after them
+	 *
+	 * @param AsyncTask the task, deleted by the task manager once it has been finalized
+	 */
+	void QueueAsyncParallelTask(class FOnlineAsyncTask* AsyncTask);
+
 private:
 
 	/** Interface to the session services */
@@ -133,6 +192,9 @@ private:
 	/** Interface for purchases */
 	FOnlinePurchaseNullPtr PurchaseInterface;
 
+	/** Timings of recent master server requests, dumped with "online masterserver stats" */
+	FOnlineRequestStatsPythonPtr RequestStats;
+
 	/** Online async task runnable */
 	class FOnlineAsyncTaskManagerPython* OnlineAsyncTaskThreadRunnable;
 
@@ -0,0 +1,691 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Math/RandomStream.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "OnlineSubsystem.h"
+#include "OnlineSessionSettings.h"
+#include "OnlineSubsystemPython.h"
+#include "OnlineSessionInterfacePython.h"
+#include "OnlineSessionAsyncMasterServerPython.h"
+#include "NboSerializerPython.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Headless benchmarks for the FOnlineSessionPython hot paths.
+ * Feeds synthetic master server lists and LAN beacon payloads of varying sizes through the session interface
+ * and reports the time and number of allocations per result. Run from the command line with
+ *
+ * UE4Editor-Cmd.exe OnlineSubsystemTest.uproject -ExecCmds="Automation RunTests OnlineSubsystemPython.Benchmark;Quit" -nullrhi -unattended -log
+ *
+ * OnlineSubsystemPython.Fuzz feeds mutated and random LAN host responses through the packet decoder the same way.
+ */
+
+DEFINE_LOG_CATEGORY_STATIC(LogOnlineSessionPythonBenchmark, Log, All);
+
+/** Number of servers in each synthetic master server list */
+static const int32 BenchmarkServerCounts[] = { 1, 10, 100, 1000, 5000 };
+
+/** Number of advertised settings in each synthetic LAN beacon payload */
+static const int32 BenchmarkSettingCounts[] = { 1, 4, 16, 64 };
+
+/** Minimum number of results processed per measurement so small sizes still give stable numbers */
+static const int32 BenchmarkMinResults = 20000;
+
+/** Number of mutated or random LAN responses decoded per fuzz run */
+static const int32 FuzzIterations = 200000;
+
+/** Seed of the fuzz run, fixed so a failure can be reproduced */
+static const int32 FuzzSeed = 0x5059;
+
+/**
+ * Forwards to the real allocator and counts every allocation made while installed as GMalloc.
+ * Allocations made by other threads during a measurement are counted too, so run with as little else going on as possible.
+ */
+class FBenchmarkMallocCounter : public FMalloc
+{
+public:
+
+	explicit FBenchmarkMallocCounter(FMalloc* InInnerMalloc) :
+		InnerMalloc(InInnerMalloc)
+	{
+	}
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		NumAllocations.Increment();
+		return InnerMalloc->Malloc(Count, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		NumAllocations.Increment();
+		return InnerMalloc->Realloc(Original, Count, Alignment);
+	}
+
+	virtual void Free(void* Original) override
+	{
+		InnerMalloc->Free(Original);
+	}
+
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+	{
+		return InnerMalloc->QuantizeSize(Count, Alignment);
+	}
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return InnerMalloc->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return InnerMalloc->IsInternallyThreadSafe();
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return TEXT("BenchmarkMallocCounter");
+	}
+
+	/** Allocations seen since this counter was created */
+	FThreadSafeCounter NumAllocations;
+
+private:
+
+	/** Allocator doing the actual work */
+	FMalloc* InnerMalloc;
+};
+
+/**
+ * Measures wall time and allocations between construction and Stop()
+ */
+class FBenchmarkMeasurement
+{
+public:
+
+	FBenchmarkMeasurement() :
+		Counter(GMalloc),
+		PreviousMalloc(GMalloc),
+		Seconds(0.0)
+	{
+		GMalloc = &Counter;
+		StartTime = FPlatformTime::Seconds();
+	}
+
+	~FBenchmarkMeasurement()
+	{
+		Stop();
+	}
+
+	void Stop()
+	{
+		if (GMalloc == &Counter)
+		{
+			Seconds = FPlatformTime::Seconds() - StartTime;
+			GMalloc = PreviousMalloc;
+		}
+	}
+
+	double GetSeconds() const
+	{
+		return Seconds;
+	}
+
+	/** Formats the per-result cost of the measured work */
+	FString ToString(int32 NumResults) const
+	{
+		return FString::Printf(TEXT("%.3f us/result, %.1f allocs/result"),
+			(Seconds * 1000000.0) / FMath::Max(NumResults, 1),
+			(double)Counter.NumAllocations.GetValue() / FMath::Max(NumResults, 1));
+	}
+
+private:
+
+	FBenchmarkMallocCounter Counter;
+	FMalloc* PreviousMalloc;
+	double StartTime;
+	double Seconds;
+};
+
+/**
+ * Stand-in for a master server response, converting the body on every call like the platform responses do
+ */
+class FBenchmarkHttpResponse : public IHttpResponse
+{
+public:
+
+	explicit FBenchmarkHttpResponse(const FString& InContent)
+	{
+		FTCHARToUTF8 Converter(*InContent);
+		Content.Append((const uint8*)Converter.Get(), Converter.Length());
+	}
+
+	virtual int32 GetResponseCode() const override { return EHttpResponseCodes::Ok; }
+	virtual FString GetContentAsString() const override
+	{
+		FUTF8ToTCHAR Converter((const ANSICHAR*)Content.GetData(), Content.Num());
+		return FString(Converter.Length(), Converter.Get());
+	}
+
+	virtual FString GetURL() const override { return TEXT("http://127.0.0.1:8081/get_serverlist"); }
+	virtual FString GetURLParameter(const FString& ParameterName) const override { return FString(); }
+	virtual FString GetHeader(const FString& HeaderName) const override { return FString(); }
+	virtual TArray<FString> GetAllHeaders() const override { return TArray<FString>(); }
+	virtual FString GetContentType() const override { return TEXT("application/json"); }
+	virtual int32 GetContentLength() const override { return Content.Num(); }
+	virtual const TArray<uint8>& GetContent() const override { return Content; }
+
+private:
+
+	/** UTF-8 body as it would come off the wire */
+	TArray<uint8> Content;
+};
+
+/**
+ * Friend of FOnlineSessionPython giving the benchmarks access to its private hot paths
+ */
+class FOnlineSessionPythonBenchmark
+{
+public:
+
+	/** Gets the Python session interface, if the Python subsystem is loaded */
+	static FOnlineSessionPython* GetSessionInterface()
+	{
+		IOnlineSubsystem* Subsystem = IOnlineSubsystem::Get(FName(TEXT("Python")));
+		if (Subsystem == nullptr)
+		{
+			return nullptr;
+		}
+		return static_cast<FOnlineSessionPython*>(Subsystem->GetSessionInterface().Get());
+	}
+
+	/** Makes the get_serverlist task of a FindSessions with its response already arrived, so ticking it processes the response instead of sending a request */
+	static TUniquePtr<FOnlineAsyncTaskPythonGetServerList> MakeServerListTask(const FHttpResponsePtr& Response)
+	{
+		FOnlineSubsystemPython* Subsystem = static_cast<FOnlineSubsystemPython*>(IOnlineSubsystem::Get(FName(TEXT("Python"))));
+		TUniquePtr<FOnlineAsyncTaskPythonGetServerList> Task = MakeUnique<FOnlineAsyncTaskPythonGetServerList>(Subsystem);
+		Task->SetResponse(Response, true);
+		return Task;
+	}
+
+	/** Parses the response and builds the results, the part of the task run on the online thread */
+	static void ProcessServerList(FOnlineAsyncTaskPythonGetServerList& Task)
+	{
+		Task.Tick();
+	}
+
+	/** Hands the results to the search and completes it, the part of the task left on the game thread */
+	static void FinalizeServerList(FOnlineSessionPython& SessionInt, FOnlineAsyncTaskPythonGetServerList& Task, const TSharedRef<FOnlineSessionSearch>& Search)
+	{
+		SessionInt.CurrentSessionSearch = Search;
+		SessionInt.ServerListTask = &Task;
+		Task.Finalize();
+		Task.TriggerDelegates();
+	}
+
+	static void AppendSessionSettingsToPacket(FOnlineSessionPython& SessionInt, FNboSerializeToBufferNull& Packet, FOnlineSessionSettings& SessionSettings)
+	{
+		SessionInt.AppendSessionSettingsToPacket(Packet, &SessionSettings);
+	}
+
+	static void ReadSettingsFromPacket(FOnlineSessionPython& SessionInt, FNboSerializeFromBufferNull& Packet, FOnlineSessionSettings& SessionSettings)
+	{
+		SessionInt.ReadSettingsFromPacket(Packet, SessionSettings);
+	}
+
+	/** Runs a LAN host response through the same path as one received by the beacon */
+	static void LANResponse(FOnlineSessionPython& SessionInt, const TSharedRef<FOnlineSessionSearch>& Search, uint8* PacketData, int32 PacketLength)
+	{
+		TSharedPtr<FOnlineSessionSearch> PreviousSearch = SessionInt.CurrentSessionSearch;
+		SessionInt.CurrentSessionSearch = Search;
+		SessionInt.OnValidResponsePacketReceived(PacketData, PacketLength);
+		SessionInt.CurrentSessionSearch = PreviousSearch;
+	}
+};
+
+/** Builds a get_serverlist body with the same fields and value types the master server sends */
+static FString MakeServerListJson(int32 NumServers)
+{
+	FString Json = TEXT("{\"error\": false, \"message\": \"\", \"servers\": [");
+	for (int32 Index = 0; Index < NumServers; Index++)
+	{
+		Json += FString::Printf(TEXT("%s{\"name\": \"Benchmark Server %d\", \"port\": \"%d\", \"map\": \"ThirdPersonExampleMap\", \"playercount\": \"%d\", \"maxplayers\": \"16\", \"pwprotected\": \"false\", \"gamemode\": \"Deathmatch\", \"ip\": \"10.0.%d.%d\"}"),
+			Index > 0 ? TEXT(", ") : TEXT(""), Index, 7777 + Index, Index % 17, (Index / 250) % 256, Index % 250 + 1);
+	}
+	Json += TEXT("]}");
+	return Json;
+}
+
+/** Builds session settings with the given number of advertised keys, alternating string and integer values */
+static FOnlineSessionSettings MakeSessionSettings(int32 NumSettings)
+{
+	FOnlineSessionSettings SessionSettings;
+	SessionSettings.NumPublicConnections = 16;
+	SessionSettings.bShouldAdvertise = true;
+	SessionSettings.bAllowJoinInProgress = true;
+	SessionSettings.bUsesPresence = true;
+	for (int32 Index = 0; Index < NumSettings; Index++)
+	{
+		const FName Key(*FString::Printf(TEXT("BENCHMARKKEY%d"), Index));
+		if (Index % 2 == 0)
+		{
+			SessionSettings.Set(Key, FString::Printf(TEXT("Benchmark value %d"), Index), EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		}
+		else
+		{
+			SessionSettings.Set(Key, Index, EOnlineDataAdvertisementType::ViaOnlineServiceAndPing);
+		}
+	}
+	return SessionSettings;
+}
+
+/** Builds one session record the way a host serializes it, with the given number of advertised settings */
+static TArray<uint8> MakeSessionRecord(FOnlineSessionPython& SessionInt, int32 NumSettings)
+{
+	TSharedRef<FInternetAddr> HostAddr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+	bool bIsValid = false;
+	HostAddr->SetIp(TEXT("192.168.1.10"), bIsValid);
+	HostAddr->SetPort(7777);
+
+	// Same layout as AppendSessionToPacket, without needing a registered named session
+	FNboSerializeToBufferNull Packet(64 * 1024);
+	Packet << FString(TEXT("0123456789ABCDEF0123456789ABCDEF"))
+		<< FString(TEXT("Benchmark Host"))
+		<< (int32)0
+		<< (int32)12
+		<< FString(TEXT("FEDCBA9876543210FEDCBA9876543210"))
+		<< *HostAddr;
+
+	FOnlineSessionSettings SessionSettings = MakeSessionSettings(NumSettings);
+	FOnlineSessionPythonBenchmark::AppendSessionSettingsToPacket(SessionInt, Packet, SessionSettings);
+	return TArray<uint8>(Packet.GetRawBuffer(0), Packet.GetByteCount());
+}
+
+/** Packs session records into a response the way OnValidQueryPacketReceived does */
+static TArray<uint8> MakePackedResponse(const TArray<TArray<uint8>>& Records)
+{
+	FNboSerializeToBufferNull Packet(64 * 1024);
+	Packet << (uint32)LAN_PACKED_RESPONSE_MAGIC
+		<< (uint8)LAN_PACKED_RESPONSE_VERSION
+		<< (uint8)0;
+	Packet.WriteUInt16((uint16)Records.Num());
+	for (const TArray<uint8>& Record : Records)
+	{
+		Packet.WriteUInt16((uint16)Record.Num());
+		Packet.WriteBinary(Record.GetData(), Record.Num());
+	}
+	return TArray<uint8>(Packet.GetRawBuffer(0), Packet.GetByteCount());
+}
+
+/**
+ * Decodes arbitrary bytes as a LAN host response, in the shape of a libFuzzer LLVMFuzzerTestOneInput target
+ * so it can be wrapped in one when building with a fuzzing engine. Always returns 0.
+ */
+static int32 FuzzLANResponseOneInput(FOnlineSessionPython& SessionInt, const uint8* Data, SIZE_T Size, TSharedRef<FOnlineSessionSearch>& OutSearch)
+{
+	// Exactly sized copy, so a read past the end of the packet lands outside the allocation
+	TArray<uint8> Packet;
+	Packet.Append(Data, (int32)FMath::Min<SIZE_T>(Size, MAX_int32));
+	OutSearch = MakeShared<FOnlineSessionSearch>();
+	FOnlineSessionPythonBenchmark::LANResponse(SessionInt, OutSearch, Packet.GetData(), Packet.Num());
+	return 0;
+}
+
+/** Applies one random mutation to a packet: bit flips, boundary values, truncation, extension or a repeated block */
+static void MutatePacket(FRandomStream& Random, TArray<uint8>& Packet)
+{
+	static const uint8 InterestingBytes[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+
+	switch (Random.RandRange(0, 5))
+	{
+		case 0:
+		{
+			// Flip a few bits
+			const int32 NumFlips = Random.RandRange(1, 8);
+			for (int32 Flip = 0; Flip < NumFlips && Packet.Num() > 0; Flip++)
+			{
+				Packet[Random.RandRange(0, Packet.Num() - 1)] ^= (uint8)(1 << Random.RandRange(0, 7));
+			}
+			break;
+		}
+		case 1:
+		{
+			// Boundary values, which land on lengths, counts and varint continuation bits
+			const int32 NumBytes = Random.RandRange(1, 4);
+			for (int32 Byte = 0; Byte < NumBytes && Packet.Num() > 0; Byte++)
+			{
+				Packet[Random.RandRange(0, Packet.Num() - 1)] = InterestingBytes[Random.RandRange(0, UE_ARRAY_COUNT(InterestingBytes) - 1)];
+			}
+			break;
+		}
+		case 2:
+		{
+			// Truncate
+			Packet.SetNum(Random.RandRange(0, Packet.Num()));
+			break;
+		}
+		case 3:
+		{
+			// Extend with random bytes
+			const int32 NumExtra = Random.RandRange(1, 64);
+			for (int32 Extra = 0; Extra < NumExtra; Extra++)
+			{
+				Packet.Add((uint8)Random.RandRange(0, 255));
+			}
+			break;
+		}
+		case 4:
+		{
+			// Repeat a block in place, which shifts everything after it
+			if (Packet.Num() > 0)
+			{
+				const int32 Start = Random.RandRange(0, Packet.Num() - 1);
+				const int32 Length = Random.RandRange(1, FMath::Min(32, Packet.Num() - Start));
+				TArray<uint8> Block(Packet.GetData() + Start, Length);
+				Packet.Insert(Block, Random.RandRange(0, Packet.Num()));
+			}
+			break;
+		}
+		default:
+		{
+			// Overwrite four bytes with a large length or count
+			if (Packet.Num() >= 4)
+			{
+				const int32 Offset = Random.RandRange(0, Packet.Num() - 4);
+				const uint32 Value = Random.RandRange(0, 1) ? 0x7FFFFFFF : (uint32)Random.RandRange(0x100, 0xFFFF);
+				Packet[Offset] = (uint8)(Value >> 24);
+				Packet[Offset + 1] = (uint8)(Value >> 16);
+				Packet[Offset + 2] = (uint8)(Value >> 8);
+				Packet[Offset + 3] = (uint8)Value;
+			}
+			break;
+		}
+	}
+}
+
+static void ReportBenchmark(FAutomationTestBase& Test, const FString& Message)
+{
+	UE_LOG(LogOnlineSessionPythonBenchmark, Display, TEXT("%s"), *Message);
+	Test.AddInfo(Message);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOnlineSessionPythonFindSessionsBenchmark, "OnlineSubsystemPython.Benchmark.FindSessionsResponse", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FOnlineSessionPythonFindSessionsBenchmark::RunTest(const FString& Parameters)
+{
+	FOnlineSessionPython* SessionInt = FOnlineSessionPythonBenchmark::GetSessionInterface();
+	if (!TestNotNull(TEXT("Python session interface"), SessionInt))
+	{
+		return false;
+	}
+
+	for (int32 NumServers : BenchmarkServerCounts)
+	{
+		FHttpResponsePtr Response = MakeShared<FBenchmarkHttpResponse, ESPMode::ThreadSafe>(MakeServerListJson(NumServers));
+		const int32 NumRepeats = FMath::Max(1, BenchmarkMinResults / NumServers);
+
+		// Warm up once and make sure every server made it into the results
+		{
+			TSharedRef<FOnlineSessionSearch> Search = MakeShared<FOnlineSessionSearch>();
+			TUniquePtr<FOnlineAsyncTaskPythonGetServerList> Task = FOnlineSessionPythonBenchmark::MakeServerListTask(Response);
+			FOnlineSessionPythonBenchmark::ProcessServerList(*Task);
+			FOnlineSessionPythonBenchmark::FinalizeServerList(*SessionInt, *Task, Search);
+			TestEqual(FString::Printf(TEXT("Results for %d servers"), NumServers), Search->SearchResults.Num(), NumServers);
+		}
+
+		TArray<TSharedRef<FOnlineSessionSearch>> Searches;
+		TArray<TUniquePtr<FOnlineAsyncTaskPythonGetServerList>> Tasks;
+		for (int32 Repeat = 0; Repeat < NumRepeats; Repeat++)
+		{
+			Searches.Add(MakeShared<FOnlineSessionSearch>());
+			Tasks.Add(FOnlineSessionPythonBenchmark::MakeServerListTask(Response));
+		}
+
+		// Timed apart, the game thread only pays for the second half
+		FBenchmarkMeasurement OnlineThreadMeasurement;
+		for (int32 Repeat = 0; Repeat < NumRepeats; Repeat++)
+		{
+			FOnlineSessionPythonBenchmark::ProcessServerList(*Tasks[Repeat]);
+		}
+		OnlineThreadMeasurement.Stop();
+
+		FBenchmarkMeasurement GameThreadMeasurement;
+		for (int32 Repeat = 0; Repeat < NumRepeats; Repeat++)
+		{
+			FOnlineSessionPythonBenchmark::FinalizeServerList(*SessionInt, *Tasks[Repeat], Searches[Repeat]);
+		}
+		GameThreadMeasurement.Stop();
+
+		ReportBenchmark(*this, FString::Printf(TEXT("get_serverlist %5d servers, online thread: %s"), NumServers, *OnlineThreadMeasurement.ToString(NumServers * NumRepeats)));
+		ReportBenchmark(*this, FString::Printf(TEXT("get_serverlist %5d servers, game thread: %s"), NumServers, *GameThreadMeasurement.ToString(NumServers * NumRepeats)));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOnlineSessionPythonLANSettingsBenchmark, "OnlineSubsystemPython.Benchmark.LANSessionSettings", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FOnlineSessionPythonLANSettingsBenchmark::RunTest(const FString& Parameters)
+{
+	FOnlineSessionPython* SessionInt = FOnlineSessionPythonBenchmark::GetSessionInterface();
+	if (!TestNotNull(TEXT("Python session interface"), SessionInt))
+	{
+		return false;
+	}
+
+	// Large enough for every payload size, so the read benchmark always has complete data to decode
+	const uint32 UnboundedPacketSize = 64 * 1024;
+
+	for (int32 NumSettings : BenchmarkSettingCounts)
+	{
+		FOnlineSessionSettings SessionSettings = MakeSessionSettings(NumSettings);
+
+		// Write into a real beacon sized packet, like a host answering a query does
+		{
+			FNboSerializeToBufferNull Packet(LAN_BEACON_MAX_PACKET_SIZE);
+			FOnlineSessionPythonBenchmark::AppendSessionSettingsToPacket(*SessionInt, Packet, SessionSettings);
+			ReportBenchmark(*this, FString::Printf(TEXT("AppendSessionSettingsToPacket %2d settings: %u bytes%s"),
+				NumSettings, Packet.GetByteCount(), Packet.HasOverflow() ? TEXT(" (overflows the beacon packet, would not be broadcast)") : TEXT("")));
+		}
+
+		FBenchmarkMeasurement WriteMeasurement;
+		for (int32 Repeat = 0; Repeat < BenchmarkMinResults; Repeat++)
+		{
+			FNboSerializeToBufferNull Packet(LAN_BEACON_MAX_PACKET_SIZE);
+			FOnlineSessionPythonBenchmark::AppendSessionSettingsToPacket(*SessionInt, Packet, SessionSettings);
+		}
+		WriteMeasurement.Stop();
+		ReportBenchmark(*this, FString::Printf(TEXT("AppendSessionSettingsToPacket %2d settings: %s"), NumSettings, *WriteMeasurement.ToString(BenchmarkMinResults)));
+
+		FNboSerializeToBufferNull SourcePacket(UnboundedPacketSize);
+		FOnlineSessionPythonBenchmark::AppendSessionSettingsToPacket(*SessionInt, SourcePacket, SessionSettings);
+
+		// Make sure the payload survives the round trip before timing it
+		{
+			FOnlineSessionSettings ReadSettings;
+			FNboSerializeFromBufferNull Packet(SourcePacket, SourcePacket.GetByteCount());
+			FOnlineSessionPythonBenchmark::ReadSettingsFromPacket(*SessionInt, Packet, ReadSettings);
+			TestEqual(FString::Printf(TEXT("Settings read back for %d settings"), NumSettings), ReadSettings.Settings.Num(), SessionSettings.Settings.Num());
+		}
+
+		FOnlineSessionSettings ReadSettings;
+		FBenchmarkMeasurement ReadMeasurement;
+		for (int32 Repeat = 0; Repeat < BenchmarkMinResults; Repeat++)
+		{
+			FNboSerializeFromBufferNull Packet(SourcePacket, SourcePacket.GetByteCount());
+			FOnlineSessionPythonBenchmark::ReadSettingsFromPacket(*SessionInt, Packet, ReadSettings);
+		}
+		ReadMeasurement.Stop();
+		ReportBenchmark(*this, FString::Printf(TEXT("ReadSettingsFromPacket %2d settings: %s"), NumSettings, *ReadMeasurement.ToString(BenchmarkMinResults)));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOnlineSessionPythonLANResponseBenchmark, "OnlineSubsystemPython.Benchmark.LANResponseDecode", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FOnlineSessionPythonLANResponseBenchmark::RunTest(const FString& Parameters)
+{
+	FOnlineSessionPython* SessionInt = FOnlineSessionPythonBenchmark::GetSessionInterface();
+	if (!TestNotNull(TEXT("Python session interface"), SessionInt))
+	{
+		return false;
+	}
+
+	for (int32 NumSettings : BenchmarkSettingCounts)
+	{
+		// Pack as many records into a beacon sized response as a host would
+		const TArray<uint8> Record = MakeSessionRecord(*SessionInt, NumSettings);
+		TArray<TArray<uint8>> Records;
+		int32 ResponseSize = LAN_PACKED_RESPONSE_HEADER_SIZE;
+		while (ResponseSize + LAN_PACKED_RECORD_HEADER_SIZE + Record.Num() <= LAN_BEACON_MAX_PACKET_SIZE)
+		{
+			Records.Add(Record);
+			ResponseSize += LAN_PACKED_RECORD_HEADER_SIZE + Record.Num();
+		}
+		if (Records.Num() == 0)
+		{
+			ReportBenchmark(*this, FString::Printf(TEXT("LAN response %2d settings: %d byte record doesn't fit a beacon packet, skipped"), NumSettings, Record.Num()));
+			continue;
+		}
+		TArray<uint8> Response = MakePackedResponse(Records);
+
+		// Make sure every record decodes before timing it
+		{
+			TSharedRef<FOnlineSessionSearch> Search = MakeShared<FOnlineSessionSearch>();
+			FOnlineSessionPythonBenchmark::LANResponse(*SessionInt, Search, Response.GetData(), Response.Num());
+			TestEqual(FString::Printf(TEXT("Results for %d records of %d settings"), Records.Num(), NumSettings), Search->SearchResults.Num(), Records.Num());
+		}
+
+		const int32 NumRepeats = FMath::Max(1, BenchmarkMinResults / Records.Num());
+		TArray<TSharedRef<FOnlineSessionSearch>> Searches;
+		for (int32 Repeat = 0; Repeat < NumRepeats; Repeat++)
+		{
+			Searches.Add(MakeShared<FOnlineSessionSearch>());
+		}
+
+		FBenchmarkMeasurement Measurement;
+		for (int32 Repeat = 0; Repeat < NumRepeats; Repeat++)
+		{
+			FOnlineSessionPythonBenchmark::LANResponse(*SessionInt, Searches[Repeat], Response.GetData(), Response.Num());
+		}
+		Measurement.Stop();
+
+		const double Megabytes = (double)Response.Num() * NumRepeats / (1024.0 * 1024.0);
+		ReportBenchmark(*this, FString::Printf(TEXT("OnValidResponsePacketReceived %2d settings, %2d records/packet: %s, %.1f MB/s"),
+			NumSettings, Records.Num(), *Measurement.ToString(Records.Num() * NumRepeats), Megabytes / FMath::Max(Measurement.GetSeconds(), 0.000001)));
+
+		// A response claiming more records than it holds is dropped by the framing check, before anything is decoded
+		TArray<uint8> Truncated = Response;
+		Truncated.SetNum(Truncated.Num() - 1);
+		TSharedRef<FOnlineSessionSearch> RejectedSearch = MakeShared<FOnlineSessionSearch>();
+		FBenchmarkMeasurement RejectMeasurement;
+		for (int32 Repeat = 0; Repeat < BenchmarkMinResults; Repeat++)
+		{
+			FOnlineSessionPythonBenchmark::LANResponse(*SessionInt, RejectedSearch, Truncated.GetData(), Truncated.Num());
+		}
+		RejectMeasurement.Stop();
+		TestEqual(TEXT("Results from truncated responses"), RejectedSearch->SearchResults.Num(), 0);
+		ReportBenchmark(*this, FString::Printf(TEXT("OnValidResponsePacketReceived %2d settings, truncated: %s"), NumSettings, *RejectMeasurement.ToString(BenchmarkMinResults)));
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FOnlineSessionPythonLANResponseFuzz, "OnlineSubsystemPython.Fuzz.LANResponse", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::StressFilter)
+
+bool FOnlineSessionPythonLANResponseFuzz::RunTest(const FString& Parameters)
+{
+	FOnlineSessionPython* SessionInt = FOnlineSessionPythonBenchmark::GetSessionInterface();
+	if (!TestNotNull(TEXT("Python session interface"), SessionInt))
+	{
+		return false;
+	}
+
+	// Well formed responses to mutate, from a single small record up to several records with many settings
+	TArray<TArray<uint8>> Corpus;
+	for (int32 NumSettings : BenchmarkSettingCounts)
+	{
+		const TArray<uint8> Record = MakeSessionRecord(*SessionInt, NumSettings);
+		Corpus.Add(MakePackedResponse({ Record }));
+		Corpus.Add(MakePackedResponse({ Record, Record, Record }));
+	}
+
+	TSharedRef<FOnlineSessionSearch> Search = MakeShared<FOnlineSessionSearch>();
+	for (const TArray<uint8>& Seed : Corpus)
+	{
+		FuzzLANResponseOneInput(*SessionInt, Seed.GetData(), Seed.Num(), Search);
+		if (Seed.Num() <= LAN_BEACON_MAX_PACKET_SIZE && Search->SearchResults.Num() == 0)
+		{
+			AddError(FString::Printf(TEXT("Unmutated %d byte response didn't decode"), Seed.Num()));
+		}
+	}
+
+	FRandomStream Random(FuzzSeed);
+	TArray<uint8> Input;
+	int32 NumResults = 0;
+	FBenchmarkMeasurement Measurement;
+	for (int32 Iteration = 0; Iteration < FuzzIterations; Iteration++)
+	{
+		if (Random.RandRange(0, 9) == 0)
+		{
+			// Pure noise, half the time behind a valid packed header so it reaches the record decoder
+			Input = Random.RandRange(0, 1) ? MakePackedResponse({}) : TArray<uint8>();
+			const int32 NumBytes = Random.RandRange(0, LAN_BEACON_MAX_PACKET_SIZE + 16);
+			for (int32 Byte = 0; Byte < NumBytes; Byte++)
+			{
+				Input.Add((uint8)Random.RandRange(0, 255));
+			}
+		}
+		else
+		{
+			Input = Corpus[Random.RandRange(0, Corpus.Num() - 1)];
+			const int32 NumMutations = Random.RandRange(1, 4);
+			for (int32 Mutation = 0; Mutation < NumMutations; Mutation++)
+			{
+				MutatePacket(Random, Input);
+			}
+		}
+
+		FuzzLANResponseOneInput(*SessionInt, Input.GetData(), Input.Num(), Search);
+
+		// Only fully decoded sessions may reach the game
+		for (const FOnlineSessionSearchResult& Result : Search->SearchResults)
+		{
+			if (!Result.Session.OwningUserId.IsValid() || !Result.Session.SessionInfo.IsValid())
+			{
+				AddError(FString::Printf(TEXT("Iteration %d (seed %d) produced a partially decoded session"), Iteration, FuzzSeed));
+				return false;
+			}
+		}
+		NumResults += Search->SearchResults.Num();
+	}
+	Measurement.Stop();
+
+	ReportBenchmark(*this, FString::Printf(TEXT("Fuzzed %d LAN responses (seed %d), %d sessions accepted: %s"),
+		FuzzIterations, FuzzSeed, NumResults, *Measurement.ToString(FuzzIterations)));
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -13,6 +13,7 @@ Permission is granted to anyone to use this software for any purpose, including
 */
 
 using UnrealBuildTool;
+using System.IO;
 
 public class OnlineSubsystemTest : ModuleRules
 {
@@ -22,7 +23,10 @@ public class OnlineSubsystemTest : ModuleRules
 	
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "OnlineSubsystem", "OnlineSubsystemUtils" });
 
-		PrivateDependencyModuleNames.AddRange(new string[] {  });
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json", "Http", "Sockets", "OnlineSubsystemPython" });
+
+		// The session benchmarks drive the Python subsystem's private hot paths directly
+		PrivateIncludePaths.Add(Path.Combine(ModuleDirectory, "../../Plugins/OnlineSubsystemPython/Source/Private"));
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
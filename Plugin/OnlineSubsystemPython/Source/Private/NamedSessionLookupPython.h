@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+#include <atomic>
+
+class FNamedSessionPoolPython;
+
+/**
+ * Name to session table that can be read without taking SessionLock.
+ *
+ * Writers, holding SessionLock, republish the whole table after every change to the session list or a session's state,
+ * bumping a sequence number before and after (a seqlock). Readers probe the table and retry if the sequence was odd or moved
+ * while they read. Every slot field is its own atomic and readers never follow a session pointer inside the read, so a read
+ * racing a writer is only ever discarded. A reader a writer keeps interrupting gives up and the caller takes the lock instead.
+ *
+ * Sessions live in a FNamedSessionPoolPython and never move, so a session pointer found here stays valid until that session is removed.
+ */
+class FNamedSessionLookupPython
+{
+public:
+
+	/** Most sessions the table holds, lookups fall back to the locked scan while there are more */
+	static const int32 MaxSessions = 16;
+
+	FNamedSessionLookupPython();
+
+	/**
+	 * Republishes the table from the session list. Must be called with SessionLock held, after any change to the list or a session's state
+	 *
+	 * @param Sessions every named session
+	 */
+	void Publish(const FNamedSessionPoolPython& Sessions);
+
+	/**
+	 * Looks up a session without locking
+	 *
+	 * @param SessionName name of the session to find
+	 * @param OutSession set to the session, or null if there is none of that name
+	 * @param OutState set to the state of the session, or NoSession if there is none of that name
+	 *
+	 * @return false if the lookup couldn't be answered without the lock, the outputs are then left untouched
+	 */
+	bool Find(FName SessionName, FNamedOnlineSession*& OutSession, EOnlineSessionState::Type& OutState) const;
+
+	/**
+	 * Checks without locking whether any session uses presence
+	 *
+	 * @return true if a session uses presence
+	 */
+	bool HasPresenceSession() const;
+
+private:
+
+	/** Open addressed with at most half the slots used, so probes stay short */
+	static const int32 NumSlots = MaxSessions * 2;
+
+	/** Reads attempted before giving up on a writer that keeps changing the table */
+	static const int32 MaxReadAttempts = 64;
+
+	/** @return the key a name is stored under, 0 (an empty slot) for NAME_None */
+	static uint64 GetKey(FName SessionName);
+
+	/** Odd while a writer is changing the table */
+	std::atomic<uint32> Sequence;
+
+	std::atomic<uint64> SlotKeys[NumSlots];
+	std::atomic<FNamedOnlineSession*> SlotSessions[NumSlots];
+	std::atomic<uint8> SlotStates[NumSlots];
+
+	/** Set when there are more sessions than the table holds */
+	std::atomic<bool> bOverflowed;
+
+	/** Whether any session uses presence */
+	std::atomic<bool> bAnyPresenceSession;
+};
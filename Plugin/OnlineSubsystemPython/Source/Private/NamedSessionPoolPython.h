@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OnlineSessionSettings.h"
+#include "Templates/TypeCompatibleBytes.h"
+#include "Templates/UniquePtr.h"
+
+/**
+ * Refers to a session in a FNamedSessionPoolPython without keeping it alive.
+ * Resolves to null once the session is removed, even if its storage has since been reused for another session.
+ */
+struct FNamedSessionHandlePython
+{
+	/** Slot of the session in the pool */
+	int32 Index;
+
+	/** Generation of the slot when the handle was taken */
+	uint32 Generation;
+
+	FNamedSessionHandlePython() :
+		Index(INDEX_NONE),
+		Generation(0)
+	{}
+
+	/** @return true if the handle was ever taken from a session, it may still have been removed since */
+	bool IsValid() const
+	{
+		return Index != INDEX_NONE;
+	}
+};
+
+/**
+ * Named session storage that never moves a session.
+ *
+ * Sessions are constructed in place in fixed size slabs that are only freed with the pool. A session's address is stable from
+ * when it is added until it is removed, when its slot goes on a free list for the next session. Each slot counts how many
+ * sessions it has held, so a handle taken from a session stops resolving once that session is gone.
+ *
+ * Not thread safe, FOnlineSessionPython guards it with SessionLock.
+ */
+class FNamedSessionPoolPython
+{
+public:
+
+	/** Sessions allocated at a time */
+	static const int32 SessionsPerSlab = 8;
+
+	FNamedSessionPoolPython() = default;
+	FNamedSessionPoolPython(const FNamedSessionPoolPython&) = delete;
+	FNamedSessionPoolPython& operator=(const FNamedSessionPoolPython&) = delete;
+	~FNamedSessionPoolPython();
+
+	/**
+	 * Constructs a session in a free slot, allocating a new slab if there is none
+	 *
+	 * @return the new session, at an address that is stable until it is removed
+	 */
+	template <typename... ArgsType>
+	FNamedOnlineSession* Emplace(ArgsType&&... Args)
+	{
+		const int32 Index = AllocateSlot();
+		FSlot& Slot = GetSlot(Index);
+		FNamedOnlineSession* Session = new (&Slot.Storage) FNamedOnlineSession(Forward<ArgsType>(Args)...);
+		Slot.bLive = true;
+		LiveIndices.Add(Index);
+		return Session;
+	}
+
+	/**
+	 * Destroys a session and frees its slot. The last session takes its place in iteration order, no session moves in memory
+	 *
+	 * @param LiveIndex index of the session as iterated with operator[]
+	 */
+	void RemoveAt(int32 LiveIndex);
+
+	/** Destroys every session, keeping the slabs for reuse */
+	void Empty();
+
+	/**
+	 * Gets a handle that can check later whether the session still exists
+	 *
+	 * @param Session a session in this pool
+	 *
+	 * @return handle to the session, invalid if the session isn't in this pool
+	 */
+	FNamedSessionHandlePython GetHandle(const FNamedOnlineSession* Session) const;
+
+	/**
+	 * Checks a handle against the generation of its slot
+	 *
+	 * @param Handle handle taken from a session
+	 *
+	 * @return the session, or null if it has been removed
+	 */
+	FNamedOnlineSession* Resolve(const FNamedSessionHandlePython& Handle) const;
+
+	/** @return number of sessions */
+	int32 Num() const
+	{
+		return LiveIndices.Num();
+	}
+
+	/** @return the session at an index in [0, Num()), in no particular order */
+	FNamedOnlineSession& operator[](int32 LiveIndex) const
+	{
+		return *GetSlot(LiveIndices[LiveIndex]).Storage.GetTypedPtr();
+	}
+
+private:
+
+	struct FSlot
+	{
+		TTypeCompatibleBytes<FNamedOnlineSession> Storage;
+
+		/** Bumped every time the session in this slot is removed */
+		uint32 Generation;
+
+		/** Whether Storage holds a constructed session */
+		bool bLive;
+
+		FSlot() :
+			Generation(0),
+			bLive(false)
+		{}
+	};
+
+	struct FSlab
+	{
+		FSlot Slots[SessionsPerSlab];
+	};
+
+	/** @return index of a free slot, popped from the free list or from a newly allocated slab */
+	int32 AllocateSlot();
+
+	FSlot& GetSlot(int32 Index) const
+	{
+		return Slabs[Index / SessionsPerSlab]->Slots[Index % SessionsPerSlab];
+	}
+
+	/** Every slab allocated, slot index / SessionsPerSlab */
+	TArray<TUniquePtr<FSlab>> Slabs;
+
+	/** Slots not holding a session */
+	TArray<int32> FreeIndices;
+
+	/** Slots holding a session */
+	TArray<int32> LiveIndices;
+};
@@ -20,6 +20,131 @@ Permission is granted to anyone to use this software for any purpose, including
 #include "IPAddress.h"
 #include "SocketSubsystem.h"
 #include "OnlineError.h"
+#include "Misc/SecureHash.h"
+#include "GenericPlatform/GenericPlatformHttp.h"
+#include "Dom/JsonObject.h"
+#include "OnlineSubsystemPythonConfig.h"
+#include "OnlineSessionAsyncMasterServerPython.h"
+
+/** A login token is renewed this long before it expires */
+static const double AuthTokenRenewMarginSeconds = 10.0 * 60.0;
+
+/** Shortest time between two attempts to get a token for a user, so an unreachable master server isn't asked every tick */
+static const double AuthRetrySeconds = 30.0;
+
+/** Login completes without a token if the master server hasn't answered by then, so games without one aren't held up */
+static const double MasterServerLoginTimeoutSeconds = 10.0;
+
+/**
+ * Logs a local user in to the master server, login. Swaps the user's token for a new one on the same account, or gets a first token for a new account
+ */
+class FOnlineAsyncTaskPythonLogin : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InLocalUserNum the user logging in
+	 * @param bInNotifyLogin whether Login is waiting on the request, renewals complete without firing OnLoginComplete
+	 */
+	FOnlineAsyncTaskPythonLogin(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, bool bInNotifyLogin, const FString& Query) :
+		FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::Login, Query),
+		LocalUserNum(InLocalUserNum),
+		bNotifyLogin(bInNotifyLogin),
+		ExpiresInSeconds(0)
+	{
+	}
+
+	virtual void Finalize() override
+	{
+		FOnlineAsyncTaskPythonMasterServer::Finalize();
+
+		FOnlineIdentityPythonPtr IdentityInt = StaticCastSharedPtr<FOnlineIdentityPython>(Subsystem->GetIdentityInterface());
+		if (IdentityInt.IsValid())
+		{
+			IdentityInt->OnMasterServerLoginComplete(this, LocalUserNum, bWasSuccessful && !Token.IsEmpty(), AccountId, Token, ExpiresInSeconds);
+		}
+	}
+
+	virtual void TriggerDelegates() override
+	{
+		FOnlineIdentityPythonPtr IdentityInt = StaticCastSharedPtr<FOnlineIdentityPython>(Subsystem->GetIdentityInterface());
+		if (!IdentityInt.IsValid())
+		{
+			return;
+		}
+
+		if (!bWasSuccessful)
+		{
+			LogFailure(TEXT("Logging in to Master Server"));
+		}
+
+		// Not fired if the user logged out in the meantime
+		TSharedPtr<const FUniqueNetId> UserId = IdentityInt->GetUniquePlayerId(LocalUserNum);
+		if (bNotifyLogin && UserId.IsValid())
+		{
+			// The account is usable without the master server, only session requests need the token
+			IdentityInt->TriggerOnLoginCompleteDelegates(LocalUserNum, true, *UserId, FString());
+		}
+	}
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override
+	{
+		JsonObject.TryGetStringField(TEXT("id"), AccountId);
+		JsonObject.TryGetStringField(TEXT("token"), Token);
+		JsonObject.TryGetNumberField(TEXT("expires_in"), ExpiresInSeconds);
+	}
+
+private:
+
+	/** The user logging in */
+	int32 LocalUserNum;
+
+	/** Whether Login is waiting on the request */
+	bool bNotifyLogin;
+
+	/** Account the master server issued the token to */
+	FString AccountId;
+
+	/** The token issued */
+	FString Token;
+
+	/** Seconds the token is valid for */
+	int32 ExpiresInSeconds;
+};
+
+FUniqueNetIdPython::FUniqueNetIdPython(const FString& Str)
+{
+	if (!FGuid::ParseExact(Str, EGuidFormats::Digits, Guid))
+	{
+		// Not written by ToString, map it onto an id the same way every time
+		FMD5 Md5;
+		Md5.Update(reinterpret_cast<const uint8*>(*Str), Str.Len() * sizeof(TCHAR));
+		Md5.Final(reinterpret_cast<uint8*>(&Guid));
+	}
+	Hash = GetTypeHash(Guid);
+}
+
+FUniqueNetIdPython::FUniqueNetIdPython(const FUniqueNetId& Src)
+{
+	if (Src.GetType() == GetTypeName())
+	{
+		const FUniqueNetIdPython& SrcPython = static_cast<const FUniqueNetIdPython&>(Src);
+		Guid = SrcPython.Guid;
+		Hash = SrcPython.Hash;
+	}
+	else
+	{
+		*this = FUniqueNetIdPython(Src.ToString());
+	}
+}
+
+FUniqueNetIdPython::FUniqueNetIdPython(const uint8* InBytes)
+{
+	FMemory::Memcpy(&Guid, InBytes, IdSize);
+	Hash = GetTypeHash(Guid);
+}
 
 bool FUserOnlineAccountPython::GetAuthAttribute(const FString& AttrName, FString& OutAttrValue) const
 {
@@ -98,9 +223,10 @@ bool FOnlineIdentityPython::Login(int32 LocalUserNum, const FOnlineAccountCreden
 		{
 			FString RandomUserId = GenerateRandomUserId(LocalUserNum);
 
-			FUniqueNetIdPython NewUserId(RandomUserId);
+			// The generated string stays the player's nickname, the id is the 128 bits it maps onto
 			UserAccountPtr = MakeShareable(new FUserOnlineAccountPython(RandomUserId));
-			UserAccountPtr->UserAttributes.Add(USER_ATTR_ID, RandomUserId);
+			const FUniqueNetIdPython& NewUserId = static_cast<const FUniqueNetIdPython&>(*UserAccountPtr->GetUserId());
+			UserAccountPtr->UserAttributes.Add(USER_ATTR_ID, NewUserId.ToString());
 
 			// update/add cached entry for user
 			UserAccounts.Add(NewUserId, UserAccountPtr.ToSharedRef());
@@ -110,8 +236,8 @@ bool FOnlineIdentityPython::Login(int32 LocalUserNum, const FOnlineAccountCreden
 		}
 		else
 		{
-			const FUniqueNetIdPython* UniqueIdStr = (FUniqueNetIdPython*)(UserId->Get());
-			TSharedRef<FUserOnlineAccountPython>* TempPtr = UserAccounts.Find(*UniqueIdStr);
+			const FUniqueNetIdPython* PythonUserId = (FUniqueNetIdPython*)(UserId->Get());
+			TSharedRef<FUserOnlineAccountPython>* TempPtr = UserAccounts.Find(*PythonUserId);
 			check(TempPtr);
 			UserAccountPtr = *TempPtr;
 		}
@@ -124,15 +250,147 @@ bool FOnlineIdentityPython::Login(int32 LocalUserNum, const FOnlineAccountCreden
 		return false;
 	}
 
-	TriggerOnLoginCompleteDelegates(LocalUserNum, true, *UserAccountPtr->GetUserId(), ErrorStr);
+	if (PendingMasterServerLogins.Contains(LocalUserNum))
+	{
+		// Already getting a token, the account itself is ready
+		TriggerOnLoginCompleteDelegates(LocalUserNum, true, *UserAccountPtr->GetUserId(), ErrorStr);
+		return true;
+	}
+
+	// The account can be used straight away, OnLoginComplete fires once the master server has issued a token or failed to
+	QueueMasterServerLogin(LocalUserNum, *UserAccountPtr, true);
+	return true;
+}
+
+void FOnlineIdentityPython::QueueMasterServerLogin(int32 LocalUserNum, FUserOnlineAccountPython& Account, bool bNotifyLogin)
+{
+	UOnlineSubsystemPythonConfig* Config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
+	// The token is bound to the player, the master server only holds slots along with the player the token is for
+	FString Query = FString::Printf(TEXT("?ticket=%s&player=%s"), *FGenericPlatformHttp::UrlEncode(Config->AuthorizationTicket), *Account.GetUserId()->ToString());
+	if (!Account.AuthToken.IsEmpty())
+	{
+		// Keeps the account the token was issued to
+		Query += FString::Printf(TEXT("&token=%s"), *FGenericPlatformHttp::UrlEncode(Account.AuthToken));
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	Account.NextAuthAttemptInSeconds = Now + AuthRetrySeconds;
+
+	FOnlineAsyncTaskPythonLogin* Task = new FOnlineAsyncTaskPythonLogin(PythonSubsystem, LocalUserNum, bNotifyLogin, Query);
+	FPendingLogin& Pending = PendingMasterServerLogins.Add(LocalUserNum);
+	Pending.Task = Task;
+	Pending.DeadlineInSeconds = Now + MasterServerLoginTimeoutSeconds;
+	PythonSubsystem->QueueAsyncParallelTask(Task);
+}
+
+void FOnlineIdentityPython::OnMasterServerLoginComplete(const FOnlineAsyncTaskPythonLogin* Task, int32 LocalUserNum, bool bWasSuccessful, const FString& AccountId, const FString& Token, int32 ExpiresInSeconds)
+{
+	const FPendingLogin* Pending = PendingMasterServerLogins.Find(LocalUserNum);
+	if (Pending == nullptr || Pending->Task != Task)
+	{
+		return;
+	}
+	PendingMasterServerLogins.Remove(LocalUserNum);
+
+	FUserOnlineAccountPython* Account = GetLocalUserAccount(LocalUserNum);
+	if (Account == nullptr)
+	{
+		return;
+	}
+
+	if (bWasSuccessful)
+	{
+		Account->AuthToken = Token;
+		Account->AuthTokenExpiryInSeconds = FPlatformTime::Seconds() + ExpiresInSeconds;
+		Account->AdditionalAuthData.Add(TEXT("masterserver_account"), AccountId);
+		UE_LOG_ONLINE_IDENTITY(Log, TEXT("Logged in to the master server as %s"), *AccountId);
+	}
+	else if (Account->AuthToken.IsEmpty())
+	{
+		UE_LOG_ONLINE_IDENTITY(Warning, TEXT("Could not log in to the master server, session requests are sent without a login token"));
+	}
+}
+
+void FOnlineIdentityPython::OnAuthTokenRejected(int32 LocalUserNum, const FString& Token)
+{
+	FUserOnlineAccountPython* Account = GetLocalUserAccount(LocalUserNum);
+	if (Account == nullptr || Account->AuthToken != Token || PendingMasterServerLogins.Contains(LocalUserNum) ||
+		FPlatformTime::Seconds() < Account->NextAuthAttemptInSeconds)
+	{
+		return;
+	}
+
+	UE_LOG_ONLINE_IDENTITY(Warning, TEXT("Master server rejected the login token, logging in again"));
+	QueueMasterServerLogin(LocalUserNum, *Account, false);
+}
+
+bool FOnlineIdentityPython::EnsureMasterServerLogin(int32 LocalUserNum)
+{
+	if (PendingMasterServerLogins.Contains(LocalUserNum))
+	{
+		return true;
+	}
+
+	// A failed attempt isn't repeated before AuthRetrySeconds, the request then goes without a token and is refused
+	FUserOnlineAccountPython* Account = GetLocalUserAccount(LocalUserNum);
+	if (Account == nullptr || !Account->AuthToken.IsEmpty() || FPlatformTime::Seconds() < Account->NextAuthAttemptInSeconds)
+	{
+		return false;
+	}
+
+	QueueMasterServerLogin(LocalUserNum, *Account, false);
 	return true;
 }
 
+void FOnlineIdentityPython::Tick(float DeltaTime)
+{
+	const double Now = FPlatformTime::Seconds();
+	for (const TPair<int32, FPendingLogin>& Pending : PendingMasterServerLogins)
+	{
+		if (Now >= Pending.Value.DeadlineInSeconds)
+		{
+			// Completes as failed on the online thread
+			Pending.Value.Task->Cancel();
+		}
+	}
+
+	for (const TPair<int32, TSharedPtr<const FUniqueNetId>>& UserId : UserIds)
+	{
+		FUserOnlineAccountPython* Account = GetLocalUserAccount(UserId.Key);
+		if (Account != nullptr &&
+			!Account->AuthToken.IsEmpty() &&
+			Now >= Account->AuthTokenExpiryInSeconds - AuthTokenRenewMarginSeconds &&
+			Now >= Account->NextAuthAttemptInSeconds &&
+			!PendingMasterServerLogins.Contains(UserId.Key))
+		{
+			QueueMasterServerLogin(UserId.Key, *Account, false);
+		}
+	}
+}
+
+FUserOnlineAccountPython* FOnlineIdentityPython::GetLocalUserAccount(int32 LocalUserNum) const
+{
+	const TSharedPtr<const FUniqueNetId>* UserId = UserIds.Find(LocalUserNum);
+	if (UserId == NULL || !UserId->IsValid())
+	{
+		return nullptr;
+	}
+
+	const TSharedRef<FUserOnlineAccountPython>* Account = UserAccounts.Find(FUniqueNetIdPython(**UserId));
+	return Account ? &Account->Get() : nullptr;
+}
+
 bool FOnlineIdentityPython::Logout(int32 LocalUserNum)
 {
 	TSharedPtr<const FUniqueNetId> UserId = GetUniquePlayerId(LocalUserNum);
 	if (UserId.IsValid())
 	{
+		// stop logging in to the master server, the login completes without touching the removed account
+		if (const FPendingLogin* Pending = PendingMasterServerLogins.Find(LocalUserNum))
+		{
+			Pending->Task->Cancel();
+		}
+
 		// remove cached user account
 		UserAccounts.Remove(FUniqueNetIdPython(*UserId));
 		// remove cached user id
@@ -193,8 +451,8 @@ TSharedPtr<FUserOnlineAccount> FOnlineIdentityPython::GetUserAccount(const FUniq
 {
 	TSharedPtr<FUserOnlineAccount> Result;
 
-	FUniqueNetIdPython StringUserId(UserId);
-	const TSharedRef<FUserOnlineAccountPython>* FoundUserAccount = UserAccounts.Find(StringUserId);
+	FUniqueNetIdPython PythonUserId(UserId);
+	const TSharedRef<FUserOnlineAccountPython>* FoundUserAccount = UserAccounts.Find(PythonUserId);
 	if (FoundUserAccount != NULL)
 	{
 		Result = *FoundUserAccount;
@@ -227,9 +485,15 @@ TSharedPtr<const FUniqueNetId> FOnlineIdentityPython::GetUniquePlayerId(int32 Lo
 
 TSharedPtr<const FUniqueNetId> FOnlineIdentityPython::CreateUniquePlayerId(uint8* Bytes, int32 Size)
 {
-	if (Bytes != NULL && Size > 0)
+	if (Bytes != NULL && Size == FUniqueNetIdPython::IdSize)
+	{
+		// The binary form returned by GetBytes
+		return MakeShareable(new FUniqueNetIdPython(Bytes));
+	}
+	else if (Bytes != NULL && Size > 0)
 	{
-		FString StrId(Size, (TCHAR*)Bytes);
+		// Older builds passed the id's characters
+		FString StrId(Size / sizeof(TCHAR), (TCHAR*)Bytes);
 		return MakeShareable(new FUniqueNetIdPython(StrId));
 	}
 	return NULL;
@@ -266,7 +530,7 @@ FString FOnlineIdentityPython::GetPlayerNickname(int32 LocalUserNum) const
 	TSharedPtr<const FUniqueNetId> UniqueId = GetUniquePlayerId(LocalUserNum);
 	if (UniqueId.IsValid())
 	{
-		return UniqueId->ToString();
+		return GetPlayerNickname(*UniqueId);
 	}
 
 	return TEXT("NullUser");
@@ -274,6 +538,11 @@ FString FOnlineIdentityPython::GetPlayerNickname(int32 LocalUserNum) const
 
 FString FOnlineIdentityPython::GetPlayerNickname(const FUniqueNetId& UserId) const
 {
+	const TSharedRef<FUserOnlineAccountPython>* FoundUserAccount = UserAccounts.Find(FUniqueNetIdPython(UserId));
+	if (FoundUserAccount != NULL)
+	{
+		return (*FoundUserAccount)->UserName;
+	}
 	return UserId.ToString();
 }
 
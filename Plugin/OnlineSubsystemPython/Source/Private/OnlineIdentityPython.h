@@ -21,6 +21,7 @@ Permission is granted to anyone to use this software for any purpose, including
 #include "OnlineSubsystemPythonTypes.h"
 
 class FOnlineSubsystemPython;
+class FOnlineAsyncTaskPythonLogin;
 
 /**
  * Info associated with an user account generated by this online service
@@ -41,13 +42,16 @@ public:
 
 	// FUserOnlineAccount
 
-	virtual FString GetAccessToken() const override { return TEXT("DummyAuthTicket"); }
+	virtual FString GetAccessToken() const override { return AuthToken; }
 	virtual bool GetAuthAttribute(const FString& AttrName, FString& OutAttrValue) const override;
 
 	// FUserOnlineAccountPython
 
 	FUserOnlineAccountPython(const FString& InUserId=TEXT("")) 
 		: UserIdPtr(new FUniqueNetIdPython(InUserId))
+		, UserName(InUserId)
+		, AuthTokenExpiryInSeconds(0.0)
+		, NextAuthAttemptInSeconds(0.0)
 	{ }
 
 	virtual ~FUserOnlineAccountPython()
@@ -57,6 +61,18 @@ public:
 	/** User Id represented as a FUniqueNetId */
 	TSharedRef<const FUniqueNetId> UserIdPtr;
 
+	/** String the id was made from, kept as the player's nickname */
+	FString UserName;
+
+	/** Token the master server issued at login, attached to session requests. Empty until the master server has answered */
+	FString AuthToken;
+
+	/** Time (FPlatformTime::Seconds) AuthToken expires */
+	double AuthTokenExpiryInSeconds;
+
+	/** Earliest time (FPlatformTime::Seconds) to ask the master server for a new token after the last attempt */
+	double NextAuthAttemptInSeconds;
+
         /** Additional key/value pair data related to auth */
 	TMap<FString, FString> AdditionalAuthData;
         /** Additional key/value pair data related to user attribution */
@@ -104,6 +120,51 @@ public:
 	 */
 	virtual ~FOnlineIdentityPython();
 
+	/** Local user whose login token authenticates session requests, the hosting player */
+	static const int32 MasterServerUserNum = 0;
+
+	/**
+	 * Renews login tokens before they expire, and after the master server rejected one
+	 *
+	 * @param DeltaTime the time since the last tick
+	 */
+	void Tick(float DeltaTime);
+
+	/**
+	 * Stores the result of logging in to the master server on the user's account
+	 *
+	 * @param Task the login request, ignored if it was superseded
+	 * @param LocalUserNum the user that logged in
+	 * @param bWasSuccessful whether the master server issued a token
+	 * @param AccountId account the master server issued the token to
+	 * @param Token the token, attached to session requests from now on
+	 * @param ExpiresInSeconds seconds the token is valid for
+	 */
+	void OnMasterServerLoginComplete(const FOnlineAsyncTaskPythonLogin* Task, int32 LocalUserNum, bool bWasSuccessful, const FString& AccountId, const FString& Token, int32 ExpiresInSeconds);
+
+	/**
+	 * Logs the user in to the master server again after it rejected their token
+	 *
+	 * @param LocalUserNum the user the token belongs to
+	 * @param Token the token that was rejected, ignored if the user already has a newer one
+	 */
+	void OnAuthTokenRejected(int32 LocalUserNum, const FString& Token);
+
+	/**
+	 * Starts logging a user in to the master server if they have no token yet and aren't already logging in
+	 *
+	 * @param LocalUserNum the user whose token requests are sent with
+	 *
+	 * @return true if a login is in flight, requests made before it completes would go without a token
+	 */
+	bool EnsureMasterServerLogin(int32 LocalUserNum);
+
+	/** @return true if a master server login for the user is in flight */
+	bool IsLoggingInToMasterServer(int32 LocalUserNum) const
+	{
+		return PendingMasterServerLogins.Contains(LocalUserNum);
+	}
+
 private:
 
 	/**
@@ -111,9 +172,34 @@ private:
 	 */
 	FOnlineIdentityPython() = delete;
 
+	/**
+	 * Asks the master server for a login token for a user, renewing the one they have if any
+	 *
+	 * @param LocalUserNum the user to log in
+	 * @param Account the user's account
+	 * @param bNotifyLogin whether Login is waiting on it, to fire OnLoginComplete once it completes
+	 */
+	void QueueMasterServerLogin(int32 LocalUserNum, FUserOnlineAccountPython& Account, bool bNotifyLogin);
+
+	/** @return the account of a local user, null if they aren't logged in */
+	FUserOnlineAccountPython* GetLocalUserAccount(int32 LocalUserNum) const;
+
 	/** Cached pointer to owning subsystem */
 	FOnlineSubsystemPython* PythonSubsystem;
 
+	/** A master server login in flight */
+	struct FPendingLogin
+	{
+		/** The request, owned by the async task manager until it completes */
+		FOnlineAsyncTaskPythonLogin* Task;
+
+		/** Time (FPlatformTime::Seconds) the request is cancelled if the master server hasn't answered */
+		double DeadlineInSeconds;
+	};
+
+	/** Master server logins in flight, by local user */
+	TMap<int32, FPendingLogin> PendingMasterServerLogins;
+
 	/** Ids mapped to locally registered users */
 	TMap<int32, TSharedPtr<const FUniqueNetId>> UserIds;
 
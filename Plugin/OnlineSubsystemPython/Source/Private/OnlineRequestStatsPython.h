@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Misc/ScopeLock.h"
+
+DECLARE_STATS_GROUP(TEXT("OnlinePython"), STATGROUP_OnlinePython, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build Request"), STAT_PythonRequest_Build, STATGROUP_OnlinePython, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Parse Response"), STAT_PythonRequest_Parse, STATGROUP_OnlinePython, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Build Results"), STAT_PythonRequest_Results, STATGROUP_OnlinePython, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Dispatch Delegates"), STAT_PythonRequest_Dispatch, STATGROUP_OnlinePython, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Requests In Flight"), STAT_PythonRequestsInFlight, STATGROUP_OnlinePython, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Requests Completed"), STAT_PythonRequestsCompleted, STATGROUP_OnlinePython, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Requests Failed"), STAT_PythonRequestsFailed, STATGROUP_OnlinePython, );
+
+/** Master server requests made by the plugin */
+namespace EPythonRequest
+{
+	enum Type
+	{
+		RegisterServer,
+		UpdateServer,
+		UnregisterServer,
+		Heartbeat,
+		GetServerList,
+		Login,
+		GetServer,
+		FindFriendSessions,
+		Matchmake,
+		ReserveSlot,
+		GroupJoin,
+		Num
+	};
+
+	/** @return the master server endpoint the request type calls */
+	inline const TCHAR* ToString(EPythonRequest::Type RequestType)
+	{
+		switch (RequestType)
+		{
+			case RegisterServer: return TEXT("register_server");
+			case UpdateServer: return TEXT("update_server");
+			case UnregisterServer: return TEXT("unregister_server");
+			case Heartbeat: return TEXT("perform_heartbeat");
+			case GetServerList: return TEXT("get_serverlist");
+			case Login: return TEXT("login");
+			case GetServer: return TEXT("get_server");
+			case FindFriendSessions: return TEXT("find_friend_sessions");
+			case Matchmake: return TEXT("matchmake");
+			case ReserveSlot: return TEXT("reserve_slots");
+			case GroupJoin: return TEXT("group_join");
+		}
+		return TEXT("");
+	}
+}
+
+/** Phases of a master server request that are timed separately */
+namespace EPythonRequestPhase
+{
+	enum Type
+	{
+		/** Building the request on the game thread */
+		Build,
+		/** Time between issuing the request and the response arriving */
+		Network,
+		/** Deserializing the response JSON */
+		Parse,
+		/** Turning the parsed response into session state or search results */
+		Results,
+		/** Triggering the completion delegates */
+		Dispatch,
+		Num
+	};
+
+	inline const TCHAR* ToString(EPythonRequestPhase::Type Phase)
+	{
+		switch (Phase)
+		{
+			case Build: return TEXT("build");
+			case Network: return TEXT("network");
+			case Parse: return TEXT("parse");
+			case Results: return TEXT("results");
+			case Dispatch: return TEXT("dispatch");
+		}
+		return TEXT("");
+	}
+}
+
+/**
+ * Keeps the recent timings of every master server request phase, so they can be dumped from the console
+ * with "online masterserver stats". Safe to record from any thread.
+ */
+class FOnlineRequestStatsPython
+{
+public:
+
+	FOnlineRequestStatsPython();
+
+	/** Records how long a phase of a request took */
+	void AddSample(EPythonRequest::Type RequestType, EPythonRequestPhase::Type Phase, double Seconds);
+
+	/** Records a request being sent to the master server */
+	void RequestStarted(EPythonRequest::Type RequestType);
+
+	/** Records a request finishing, successfully or not */
+	void RequestCompleted(EPythonRequest::Type RequestType, bool bWasSuccessful);
+
+	/** Writes counts, percentiles and a latency histogram of every phase to the output device */
+	void Dump(FOutputDevice& Ar) const;
+
+	/** Forgets all recorded samples and counts */
+	void Reset();
+
+private:
+
+	/** Number of recent samples kept per request phase */
+	static const int32 MaxSamples = 256;
+
+	/** Ring buffer of the most recent samples of a request phase, in seconds */
+	struct FSampleHistory
+	{
+		TArray<float> Samples;
+		int32 NextSample;
+
+		FSampleHistory() : NextSample(0) {}
+	};
+
+	FSampleHistory Histories[EPythonRequest::Num][EPythonRequestPhase::Num];
+	int32 NumStarted[EPythonRequest::Num];
+	int32 NumCompleted[EPythonRequest::Num];
+	int32 NumFailed[EPythonRequest::Num];
+
+	mutable FCriticalSection StatsLock;
+};
+
+typedef TSharedPtr<FOnlineRequestStatsPython, ESPMode::ThreadSafe> FOnlineRequestStatsPythonPtr;
+
+/**
+ * Adds the time spent in its scope to a request phase of the request stats
+ */
+class FScopedRequestPhaseTimer
+{
+public:
+
+	FScopedRequestPhaseTimer(FOnlineRequestStatsPython& InStats, EPythonRequest::Type InRequestType, EPythonRequestPhase::Type InPhase) :
+		Stats(InStats),
+		RequestType(InRequestType),
+		Phase(InPhase),
+		StartTime(FPlatformTime::Seconds())
+	{
+	}
+
+	~FScopedRequestPhaseTimer()
+	{
+		Stats.AddSample(RequestType, Phase, FPlatformTime::Seconds() - StartTime);
+	}
+
+private:
+
+	FOnlineRequestStatsPython& Stats;
+	EPythonRequest::Type RequestType;
+	EPythonRequestPhase::Type Phase;
+	double StartTime;
+};
+
+/** Times the rest of the scope in both the OnlinePython stat group and the request history of the given request type */
+#define SCOPE_PYTHON_REQUEST_PHASE(Stats, RequestType, Phase) \
+	SCOPE_CYCLE_COUNTER(STAT_PythonRequest_##Phase); \
+	FScopedRequestPhaseTimer ANONYMOUS_VARIABLE(PythonRequestPhaseTimer)(Stats, RequestType, EPythonRequestPhase::Phase)
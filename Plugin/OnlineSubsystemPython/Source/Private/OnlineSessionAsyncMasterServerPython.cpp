@@ -0,0 +1,739 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "OnlineSessionAsyncMasterServerPython.h"
+#include "OnlineSubsystem.h"
+#include "OnlineSessionInterfacePython.h"
+#include "OnlineSubsystemPythonTypes.h"
+#include "OnlineSubsystemPythonConfig.h"
+#include "OnlineIdentityPython.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "HttpModule.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+FOnlineAsyncTaskPythonMasterServer::FOnlineAsyncTaskPythonMasterServer(FOnlineSubsystemPython* InSubsystem, EPythonRequest::Type InRequestType, const FString& Query) :
+	FOnlineAsyncTaskBasic(InSubsystem),
+	RequestType(InRequestType),
+	bGotResponse(false),
+	ResponseCode(0),
+	bAuthRejected(false),
+	State(MakeShared<FRequestState, ESPMode::ThreadSafe>()),
+	bCancelRequested(false),
+	bCancelled(false),
+	RetryAfterSeconds(0)
+{
+	UOnlineSubsystemPythonConfig* config = GetMutableDefault<UOnlineSubsystemPythonConfig>();
+	URL = FString::Printf(TEXT("http://%s/%s%s"), *config->ServerAddress, EPythonRequest::ToString(RequestType), *Query);
+
+	// Login passes its token in the query to swap it for a new one
+	FOnlineIdentityPythonPtr IdentityInt = StaticCastSharedPtr<FOnlineIdentityPython>(Subsystem->GetIdentityInterface());
+	if (RequestType != EPythonRequest::Login && IdentityInt.IsValid())
+	{
+		AuthToken = IdentityInt->GetAuthToken(FOnlineIdentityPython::MasterServerUserNum);
+	}
+}
+
+FString FOnlineAsyncTaskPythonMasterServer::ToString() const
+{
+	return FString::Printf(TEXT("FOnlineAsyncTaskPythonMasterServer %s bWasSuccessful: %d"), EPythonRequest::ToString(RequestType), WasSuccessful());
+}
+
+void FOnlineAsyncTaskPythonMasterServer::Tick()
+{
+	if (State->bCompleted)
+	{
+		ProcessCompletedRequest();
+		bIsComplete = true;
+		return;
+	}
+
+	if (bCancelRequested && !bCancelled)
+	{
+		bCancelled = true;
+		if (!Request.IsValid())
+		{
+			// Never sent, there is nothing to wait for
+			bWasSuccessful = false;
+			bIsComplete = true;
+			return;
+		}
+		Request->CancelRequest();
+	}
+	else if (!Request.IsValid() && !bCancelled)
+	{
+		IssueRequest();
+	}
+}
+
+void FOnlineAsyncTaskPythonMasterServer::IssueRequest()
+{
+	Request = FHttpModule::Get().CreateRequest();
+	Request->SetHeader(TEXT("User-Agent"), TEXT("X-UnrealEngine-Agent"));
+	Request->SetHeader(TEXT("Content-Type"), TEXT("application/json"));
+	if (!AuthToken.IsEmpty())
+	{
+		Request->SetHeader(TEXT("Authorization"), TEXT("Bearer ") + AuthToken);
+	}
+	Request->SetVerb("GET");
+	Request->SetURL(URL);
+
+	// Complete on the HTTP thread rather than waiting for the game thread to tick the HTTP manager
+	Request->SetDelegateThreadPolicy(EHttpRequestDelegateThreadPolicy::CompleteOnHttpThread);
+	TSharedRef<FRequestState, ESPMode::ThreadSafe> RequestState = State;
+	Request->OnProcessRequestComplete().BindLambda([RequestState](FHttpRequestPtr CompletedRequest, FHttpResponsePtr Response, bool bSucceeded)
+	{
+		RequestState->Response = Response;
+		RequestState->bSucceeded = bSucceeded;
+		RequestState->ElapsedTime = CompletedRequest.IsValid() ? CompletedRequest->GetElapsedTime() : -1.0;
+		RequestState->bCompleted = true;
+	});
+
+	Subsystem->GetRequestStats().RequestStarted(RequestType);
+	Request->ProcessRequest();
+}
+
+void FOnlineAsyncTaskPythonMasterServer::SetResponse(FHttpResponsePtr Response, bool bSucceeded)
+{
+	State->Response = Response;
+	State->bSucceeded = bSucceeded;
+	State->bCompleted = true;
+}
+
+void FOnlineAsyncTaskPythonMasterServer::Cancel()
+{
+	bCancelRequested = true;
+}
+
+void FOnlineAsyncTaskPythonMasterServer::ProcessCompletedRequest()
+{
+	FOnlineRequestStatsPython& Stats = Subsystem->GetRequestStats();
+	if (State->ElapsedTime >= 0.0)
+	{
+		Stats.AddSample(RequestType, EPythonRequestPhase::Network, State->ElapsedTime);
+	}
+
+	FHttpResponsePtr Response = State->Response;
+	bGotResponse = Response.IsValid();
+	ResponseCode = bGotResponse ? Response->GetResponseCode() : 0;
+	bool bSucceeded = State->bSucceeded && bGotResponse && EHttpResponseCodes::IsOk(Response->GetResponseCode());
+
+	TSharedPtr<FJsonObject> JsonObject;
+	if (bGotResponse && Response->GetContentLength() > 0)
+	{
+		SCOPE_PYTHON_REQUEST_PHASE(Stats, RequestType, Parse);
+		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Response->GetContentAsString());
+		if (!FJsonSerializer::Deserialize(Reader, JsonObject))
+		{
+			JsonObject = nullptr;
+		}
+	}
+
+	bool bError = false;
+	if (!JsonObject.IsValid() || (JsonObject->TryGetBoolField(TEXT("error"), bError) && bError))
+	{
+		bSucceeded = false;
+	}
+	if (JsonObject.IsValid())
+	{
+		JsonObject->TryGetStringField(TEXT("message"), ErrorMessage);
+	}
+	Stats.RequestCompleted(RequestType, bSucceeded);
+
+	bAuthRejected = bGotResponse && Response->GetResponseCode() == EHttpResponseCodes::Denied;
+
+	if (bGotResponse && Response->GetResponseCode() == EHttpResponseCodes::TooManyRequests)
+	{
+		// Retry-After is in seconds, fall back to a short pause if it is missing or not a number
+		RetryAfterSeconds = FMath::Clamp(FCString::Atoi(*Response->GetHeader(TEXT("Retry-After"))), 1, 300);
+	}
+
+	if (bSucceeded)
+	{
+		SCOPE_PYTHON_REQUEST_PHASE(Stats, RequestType, Results);
+		ProcessResponse(*JsonObject);
+	}
+	bWasSuccessful = bSucceeded;
+}
+
+void FOnlineAsyncTaskPythonMasterServer::Finalize()
+{
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (RetryAfterSeconds > 0 && SessionInt.IsValid())
+	{
+		SessionInt->MasterServerBackoffEndTime = FMath::Max(SessionInt->MasterServerBackoffEndTime, FPlatformTime::Seconds() + RetryAfterSeconds);
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Master server is limiting %s requests, backing off for %d seconds"), EPythonRequest::ToString(RequestType), RetryAfterSeconds);
+	}
+
+	if (bAuthRejected)
+	{
+		FOnlineIdentityPythonPtr IdentityInt = StaticCastSharedPtr<FOnlineIdentityPython>(Subsystem->GetIdentityInterface());
+		if (IdentityInt.IsValid())
+		{
+			IdentityInt->OnAuthTokenRejected(FOnlineIdentityPython::MasterServerUserNum, AuthToken);
+		}
+	}
+}
+
+FOnlineSessionPythonPtr FOnlineAsyncTaskPythonMasterServer::GetSessionInterface() const
+{
+	return StaticCastSharedPtr<FOnlineSessionPython>(Subsystem->GetSessionInterface());
+}
+
+void FOnlineAsyncTaskPythonMasterServer::LogFailure(const TCHAR* Action) const
+{
+	if (!bGotResponse)
+	{
+		UE_LOG_ONLINE_SESSION(Error, TEXT("Error %s! No Response from Master Server"), Action);
+	}
+	else
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Error %s! %s"), Action, *ErrorMessage);
+	}
+}
+
+FOnlineAsyncTaskPythonRegisterServer::FOnlineAsyncTaskPythonRegisterServer(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FNamedSessionHandlePython& InSessionHandle, const FString& Query, bool bInReregister) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::RegisterServer, Query),
+	SessionName(InSessionName),
+	SessionHandle(InSessionHandle),
+	HeartbeatDelta(0.0f),
+	bSessionDestroyed(false),
+	bReregister(bInReregister)
+{
+}
+
+void FOnlineAsyncTaskPythonRegisterServer::ProcessResponse(const FJsonObject& JsonObject)
+{
+	HeartbeatDelta = FMath::Clamp((float)JsonObject.GetNumberField(TEXT("heartbeat")) - 1.0f, 0.01f, 10000.0f);
+}
+
+void FOnlineAsyncTaskPythonRegisterServer::Finalize()
+{
+	FOnlineAsyncTaskPythonMasterServer::Finalize();
+
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	FNamedOnlineSession* Session = SessionInt.IsValid() ? SessionInt->ResolveSessionHandle(SessionHandle) : nullptr;
+	if (Session == nullptr)
+	{
+		// Destroyed while the master server was registering it, there is nothing to keep alive
+		bSessionDestroyed = true;
+		bWasSuccessful = false;
+		return;
+	}
+
+	// A session registered again keeps the state it has reached
+	if (bWasSuccessful && !bReregister)
+	{
+		SessionInt->SetSessionState(*Session, EOnlineSessionState::Pending);
+	}
+}
+
+void FOnlineAsyncTaskPythonRegisterServer::TriggerDelegates()
+{
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid())
+	{
+		return;
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::RegisterServer, Dispatch);
+	if (bReregister)
+	{
+		// Nothing waits on it, the heartbeat retries if it failed
+		if (bWasSuccessful)
+		{
+			UE_LOG_ONLINE_SESSION(Log, TEXT("Registered Python Session again after the Master Server expired it"));
+			SessionInt->StartHeartbeat(HeartbeatDelta);
+		}
+		else if (!bSessionDestroyed)
+		{
+			LogFailure(TEXT("Registering Python Session again"));
+		}
+	}
+	else if (bWasSuccessful)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Created Python Session! Heartbeat Delta: %f"), HeartbeatDelta);
+		SessionInt->TriggerOnCreateSessionCompleteDelegates(SessionName, true);
+		SessionInt->StartHeartbeat(HeartbeatDelta);
+	}
+	else if (bSessionDestroyed)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Python Session was destroyed before the Master Server registered it"));
+		SessionInt->TriggerOnCreateSessionCompleteDelegates(SessionName, false);
+	}
+	else
+	{
+		LogFailure(TEXT("Creating Python Session"));
+		SessionInt->TriggerOnCreateSessionCompleteDelegates(SessionName, false);
+		SessionInt->DestroySession(SessionName);
+	}
+}
+
+FOnlineAsyncTaskPythonHeartbeat::FOnlineAsyncTaskPythonHeartbeat(FOnlineSubsystemPython* InSubsystem, const FNamedSessionHandlePython& InSessionHandle, const FString& Query) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::Heartbeat, Query),
+	SessionHandle(InSessionHandle)
+{
+}
+
+void FOnlineAsyncTaskPythonHeartbeat::TriggerDelegates()
+{
+	if (bWasSuccessful)
+	{
+		return;
+	}
+	LogFailure(TEXT("Heartbeating Python Session"));
+
+	// The master server answered but doesn't list the session, it expired while heartbeats weren't getting through
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	FNamedOnlineSession* Session = SessionInt.IsValid() ? SessionInt->ResolveSessionHandle(SessionHandle) : nullptr;
+	if (Session != nullptr && ResponseCode == EHttpResponseCodes::Ok && !ErrorMessage.IsEmpty() && Session->SessionState != EOnlineSessionState::Destroying)
+	{
+		SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::Heartbeat, Dispatch);
+		SessionInt->QueueRegisterServer(*Session, true);
+	}
+}
+
+FOnlineAsyncTaskPythonUpdateServer::FOnlineAsyncTaskPythonUpdateServer(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FString& Query, bool bInFromUpdateSession) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::UpdateServer, Query),
+	SessionName(InSessionName),
+	bFromUpdateSession(bInFromUpdateSession)
+{
+}
+
+void FOnlineAsyncTaskPythonUpdateServer::TriggerDelegates()
+{
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid())
+	{
+		return;
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::UpdateServer, Dispatch);
+	if (bWasSuccessful)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Updated Python Session!"));
+	}
+	else
+	{
+		LogFailure(TEXT("Updating Python Session"));
+	}
+
+	if (bFromUpdateSession)
+	{
+		SessionInt->TriggerOnUpdateSessionCompleteDelegates(SessionName, bWasSuccessful);
+	}
+}
+
+FOnlineAsyncTaskPythonUnregisterServer::FOnlineAsyncTaskPythonUnregisterServer(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FString& Query, const FOnDestroySessionCompleteDelegate& InCompletionDelegate) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::UnregisterServer, Query),
+	SessionName(InSessionName),
+	CompletionDelegate(InCompletionDelegate)
+{
+}
+
+void FOnlineAsyncTaskPythonUnregisterServer::TriggerDelegates()
+{
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid())
+	{
+		return;
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::UnregisterServer, Dispatch);
+	if (bWasSuccessful)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Destroyed Python Session!"));
+	}
+	else
+	{
+		// The session is destroyed locally either way, the master server expires it once heartbeats stop
+		LogFailure(TEXT("destroying Python Session"));
+	}
+	CompletionDelegate.ExecuteIfBound(SessionName, true);
+	SessionInt->TriggerOnDestroySessionCompleteDelegates(SessionName, true);
+}
+
+/**
+ * Builds a search result from a server as listed by the master server
+ *
+ * @param Server the server's JSON object
+ * @param SocketSubsystem creates the host address
+ * @param OutResult the result to fill in
+ */
+static void ReadServerResult(const FJsonObject& Server, ISocketSubsystem* SocketSubsystem, FOnlineSessionSearchResult& OutResult)
+{
+	TSharedPtr<FOnlineSessionInfoPython> SessionInfo = MakeShareable(new FOnlineSessionInfoPython());
+	TSharedPtr<FInternetAddr> InternetAddress = SocketSubsystem->CreateInternetAddr();
+	InternetAddress->SetPort(Server.GetIntegerField(TEXT("port")));
+	bool bIsValid;
+	InternetAddress->SetIp(*Server.GetStringField(TEXT("ip")), bIsValid);
+	SessionInfo->HostAddr = InternetAddress;
+	FString SessionId;
+	if (Server.TryGetStringField(TEXT("id"), SessionId))
+	{
+		// The id the host generated for its session, which LAN responses from the same host carry too
+		SessionInfo->SessionId = FUniqueNetIdPython(SessionId);
+	}
+	OutResult.Session.SessionInfo = SessionInfo;
+	// Slots held for players on their way in are already taken off, older master servers only send the maximum
+	int32 OpenSlots = 0;
+	OutResult.Session.NumOpenPublicConnections = Server.TryGetNumberField(TEXT("openslots"), OpenSlots) ? OpenSlots : Server.GetIntegerField(TEXT("maxplayers"));
+	OutResult.Session.SessionSettings.Set(SETTING_MAPNAME, *Server.GetStringField(TEXT("map")));
+	OutResult.Session.SessionSettings.Set(SETTING_GAMEMODE, *Server.GetStringField(TEXT("gamemode")));
+	OutResult.Session.SessionSettings.Set("SERVERNAME", *Server.GetStringField(TEXT("name")));
+	OutResult.Session.SessionSettings.Set(FName(TEXT("PASSWORDPROTECTED")), Server.GetStringField(TEXT("pwprotected")));
+	OutResult.Session.SessionSettings.Set("PLAYERCOUNT", Server.GetIntegerField(TEXT("playercount")));
+	OutResult.Session.SessionSettings.Set("MAXPLAYERS", Server.GetIntegerField(TEXT("maxplayers")));
+	FString Region;
+	if (Server.TryGetStringField(TEXT("region"), Region) && !Region.IsEmpty())
+	{
+		OutResult.Session.SessionSettings.Set("REGION", Region);
+	}
+}
+
+FOnlineAsyncTaskPythonGetServer::FOnlineAsyncTaskPythonGetServer(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, const FUniqueNetIdPython& SessionId, const FOnSingleSessionResultCompleteDelegate& InCompletionDelegate) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::GetServer, FString::Printf(TEXT("?id=%s"), *SessionId.ToString())),
+	LocalUserNum(InLocalUserNum),
+	CompletionDelegate(InCompletionDelegate),
+	bFoundSession(false)
+{
+}
+
+void FOnlineAsyncTaskPythonGetServer::ProcessResponse(const FJsonObject& JsonObject)
+{
+	const TSharedPtr<FJsonObject>* ServerObject = nullptr;
+	if (JsonObject.TryGetObjectField(TEXT("server"), ServerObject))
+	{
+		ReadServerResult(**ServerObject, ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM), Result);
+		bFoundSession = true;
+	}
+}
+
+void FOnlineAsyncTaskPythonGetServer::TriggerDelegates()
+{
+	if (!bWasSuccessful)
+	{
+		LogFailure(TEXT("finding Python Session by id"));
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::GetServer, Dispatch);
+	CompletionDelegate.ExecuteIfBound(LocalUserNum, bWasSuccessful && bFoundSession, Result);
+}
+
+FOnlineAsyncTaskPythonFindFriendSessions::FOnlineAsyncTaskPythonFindFriendSessions(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, const FString& Query) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::FindFriendSessions, Query),
+	LocalUserNum(InLocalUserNum)
+{
+}
+
+void FOnlineAsyncTaskPythonFindFriendSessions::ProcessResponse(const FJsonObject& JsonObject)
+{
+	const TArray<TSharedPtr<FJsonValue>>& JsonServerList = JsonObject.GetArrayField(TEXT("servers"));
+	Results.Reserve(JsonServerList.Num());
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	for (const TSharedPtr<FJsonValue>& JsonServer : JsonServerList)
+	{
+		const TSharedPtr<FJsonObject>* ServerObject = nullptr;
+		if (JsonServer.IsValid() && JsonServer->TryGetObject(ServerObject))
+		{
+			ReadServerResult(**ServerObject, SocketSubsystem, Results.AddDefaulted_GetRef());
+		}
+	}
+}
+
+void FOnlineAsyncTaskPythonFindFriendSessions::TriggerDelegates()
+{
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid())
+	{
+		return;
+	}
+
+	if (!bWasSuccessful)
+	{
+		LogFailure(TEXT("finding friends' Python Sessions"));
+	}
+
+	// As with other subsystems, the search only succeeds if a friend is in a session
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::FindFriendSessions, Dispatch);
+	SessionInt->TriggerOnFindFriendSessionCompleteDelegates(LocalUserNum, bWasSuccessful && Results.Num() > 0, Results);
+}
+
+FOnlineAsyncTaskPythonMatchmake::FOnlineAsyncTaskPythonMatchmake(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, FName InSessionName, const FString& Query) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::Matchmake, Query),
+	LocalUserNum(InLocalUserNum),
+	SessionName(InSessionName),
+	bFoundSession(false),
+	bStale(false)
+{
+}
+
+void FOnlineAsyncTaskPythonMatchmake::ProcessResponse(const FJsonObject& JsonObject)
+{
+	const TSharedPtr<FJsonObject>* ServerObject = nullptr;
+	if (JsonObject.TryGetObjectField(TEXT("server"), ServerObject))
+	{
+		ReadServerResult(**ServerObject, ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM), Result);
+		bFoundSession = true;
+	}
+}
+
+void FOnlineAsyncTaskPythonMatchmake::Finalize()
+{
+	FOnlineAsyncTaskPythonMasterServer::Finalize();
+
+	// Matchmaking was cancelled, the slots held for us expire on the master server
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid() || SessionInt->MatchmakingTask != this)
+	{
+		bStale = true;
+		return;
+	}
+	SessionInt->MatchmakingTask = nullptr;
+
+	bFoundSession = bWasSuccessful && bFoundSession;
+	TSharedPtr<FOnlineSessionSearch> Search = SessionInt->MatchmakingSearch;
+	SessionInt->MatchmakingSearch = nullptr;
+	if (Search.IsValid())
+	{
+		if (bFoundSession)
+		{
+			Search->SearchResults.Add(Result);
+		}
+		Search->SearchState = bFoundSession ? EOnlineAsyncTaskState::Done : EOnlineAsyncTaskState::Failed;
+	}
+}
+
+void FOnlineAsyncTaskPythonMatchmake::TriggerDelegates()
+{
+	if (bStale)
+	{
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Ignoring matchmaking result, matchmaking was cancelled"));
+		return;
+	}
+
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!bWasSuccessful)
+	{
+		LogFailure(TEXT("matchmaking"));
+	}
+
+	// Joining sets the session up locally, the held slot is taken once the host registers the player
+	const bool bJoined = bFoundSession && SessionInt->JoinPythonSession(LocalUserNum, SessionName, Result, false);
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::Matchmake, Dispatch);
+	SessionInt->TriggerOnMatchmakingCompleteDelegates(SessionName, bJoined);
+}
+
+FOnlineAsyncTaskPythonReserveSlot::FOnlineAsyncTaskPythonReserveSlot(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FNamedSessionHandlePython& InSessionHandle, const FString& Query) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::ReserveSlot, Query),
+	SessionName(InSessionName),
+	SessionHandle(InSessionHandle),
+	bServerFull(false),
+	bSessionDestroyed(false)
+{
+}
+
+void FOnlineAsyncTaskPythonReserveSlot::ProcessResponse(const FJsonObject& JsonObject)
+{
+	bool bReserved = true;
+	JsonObject.TryGetBoolField(TEXT("reserved"), bReserved);
+	bServerFull = !bReserved;
+}
+
+void FOnlineAsyncTaskPythonReserveSlot::Finalize()
+{
+	FOnlineAsyncTaskPythonMasterServer::Finalize();
+
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	FNamedOnlineSession* Session = SessionInt.IsValid() ? SessionInt->ResolveSessionHandle(SessionHandle) : nullptr;
+	if (Session == nullptr)
+	{
+		// Destroyed while we waited, there is nothing left to join
+		bSessionDestroyed = true;
+		return;
+	}
+
+	// The hold is only a guard against a full server. If the master server couldn't make one the join goes ahead as it did before holds
+	if (bServerFull)
+	{
+		SessionInt->RemoveNamedSession(SessionName);
+	}
+	else
+	{
+		SessionInt->RegisterLocalPlayers(Session);
+	}
+}
+
+void FOnlineAsyncTaskPythonReserveSlot::TriggerDelegates()
+{
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid())
+	{
+		return;
+	}
+
+	if (!bWasSuccessful)
+	{
+		LogFailure(TEXT("Reserving a slot"));
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::ReserveSlot, Dispatch);
+	if (bSessionDestroyed)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Session (%s) was destroyed before a slot was reserved on it"), *SessionName.ToString());
+		SessionInt->TriggerOnJoinSessionCompleteDelegates(SessionName, EOnJoinSessionCompleteResult::UnknownError);
+	}
+	else if (bServerFull)
+	{
+		UE_LOG_ONLINE_SESSION(Log, TEXT("Not joining session (%s), the server has no free slot"), *SessionName.ToString());
+		SessionInt->TriggerOnJoinSessionCompleteDelegates(SessionName, EOnJoinSessionCompleteResult::SessionIsFull);
+	}
+	else
+	{
+		SessionInt->TriggerOnJoinSessionCompleteDelegates(SessionName, EOnJoinSessionCompleteResult::Success);
+	}
+}
+
+FOnlineAsyncTaskPythonGroupJoin::FOnlineAsyncTaskPythonGroupJoin(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, const FString& Query, const FOnSingleSessionResultCompleteDelegate& InCompletionDelegate) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::GroupJoin, Query),
+	LocalUserNum(InLocalUserNum),
+	CompletionDelegate(InCompletionDelegate),
+	bFoundSession(false)
+{
+}
+
+void FOnlineAsyncTaskPythonGroupJoin::ProcessResponse(const FJsonObject& JsonObject)
+{
+	const TSharedPtr<FJsonObject>* ServerObject = nullptr;
+	if (JsonObject.TryGetObjectField(TEXT("server"), ServerObject))
+	{
+		ReadServerResult(**ServerObject, ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM), Result);
+		bFoundSession = true;
+	}
+}
+
+void FOnlineAsyncTaskPythonGroupJoin::TriggerDelegates()
+{
+	if (!bWasSuccessful)
+	{
+		LogFailure(TEXT("finding a Python Session for a group"));
+	}
+
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::GroupJoin, Dispatch);
+	CompletionDelegate.ExecuteIfBound(LocalUserNum, bWasSuccessful && bFoundSession, Result);
+}
+
+FOnlineAsyncTaskPythonGetServerList::FOnlineAsyncTaskPythonGetServerList(FOnlineSubsystemPython* InSubsystem) :
+	FOnlineAsyncTaskPythonMasterServer(InSubsystem, EPythonRequest::GetServerList, FString()),
+	bStale(false),
+	bHybridSearch(false),
+	bFoundSessions(false)
+{
+}
+
+void FOnlineAsyncTaskPythonGetServerList::ProcessResponse(const FJsonObject& JsonObject)
+{
+	const TArray<TSharedPtr<FJsonValue>>& JsonServerList = JsonObject.GetArrayField(TEXT("servers"));
+	Results.Reserve(JsonServerList.Num());
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	for (const TSharedPtr<FJsonValue>& JsonServer : JsonServerList)
+	{
+		const TSharedPtr<FJsonObject>* ServerObject = nullptr;
+		if (!JsonServer.IsValid() || !JsonServer->TryGetObject(ServerObject))
+		{
+			continue;
+		}
+		ReadServerResult(**ServerObject, SocketSubsystem, Results.AddDefaulted_GetRef());
+	}
+}
+
+void FOnlineAsyncTaskPythonGetServerList::Finalize()
+{
+	FOnlineAsyncTaskPythonMasterServer::Finalize();
+
+	// The search this was for has been cancelled or ran out of time, don't let it leak into a newer one
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (!SessionInt.IsValid() || SessionInt->ServerListTask != this)
+	{
+		bStale = true;
+		return;
+	}
+	SessionInt->ServerListTask = nullptr;
+
+	TSharedPtr<FOnlineSessionSearch> Search = SessionInt->CurrentSessionSearch;
+	bFoundSessions = bWasSuccessful && Search.IsValid();
+	bHybridSearch = SessionInt->bHybridSearch;
+	if (bFoundSessions)
+	{
+		if (!bHybridSearch && Search->SearchResults.Num() == 0)
+		{
+			// Nothing to merge with, hand the whole list over
+			Search->SearchResults = MoveTemp(Results);
+		}
+		else
+		{
+			for (FOnlineSessionSearchResult& Result : Results)
+			{
+				SessionInt->AddSearchResult(MoveTemp(Result), false);
+			}
+		}
+	}
+
+	if (bHybridSearch)
+	{
+		// The LAN half may still be running
+		SessionInt->bHybridInternetPending = false;
+		SessionInt->bHybridSearchSucceeded |= bFoundSessions;
+	}
+	else if (Search.IsValid())
+	{
+		Search->SearchState = bFoundSessions ? EOnlineAsyncTaskState::Done : EOnlineAsyncTaskState::Failed;
+		SessionInt->CurrentSessionSearch = nullptr;
+	}
+}
+
+void FOnlineAsyncTaskPythonGetServerList::TriggerDelegates()
+{
+	if (bStale)
+	{
+		UE_LOG_ONLINE_SESSION(Verbose, TEXT("Ignoring server list for a search that is no longer running"));
+		return;
+	}
+
+	FOnlineSessionPythonPtr SessionInt = GetSessionInterface();
+	if (bFoundSessions)
+	{
+		UE_LOG_ONLINE_SESSION(Warning, TEXT("Found Python Sessions!"));
+	}
+	else if (!bWasSuccessful)
+	{
+		LogFailure(TEXT("finding Python Sessions"));
+	}
+
+	// Triggered once the search has been released, so a new search can be started from the delegates
+	SCOPE_PYTHON_REQUEST_PHASE(Subsystem->GetRequestStats(), EPythonRequest::GetServerList, Dispatch);
+	if (bHybridSearch)
+	{
+		SessionInt->TryCompleteHybridSearch();
+	}
+	else
+	{
+		SessionInt->TriggerOnFindSessionsCompleteDelegates(bFoundSessions);
+	}
+}
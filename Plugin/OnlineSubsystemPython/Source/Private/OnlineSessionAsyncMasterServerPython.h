@@ -0,0 +1,461 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "OnlineAsyncTaskManager.h"
+#include "OnlineSessionSettings.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "OnlineSubsystemPython.h"
+#include "OnlineRequestStatsPython.h"
+#include "NamedSessionPoolPython.h"
+
+class FJsonObject;
+
+/**
+ * Base of the tasks making master server requests.
+ *
+ * The request is issued from the online thread and completed by the HTTP module on its own thread. Its response is parsed and
+ * turned into results on the online thread too, leaving the game thread only the session state writes in Finalize and the
+ * delegates in TriggerDelegates. Tasks are queued in parallel, so a slow server list doesn't hold up a heartbeat.
+ *
+ * Used as is for requests with nothing to do on completion.
+ */
+class ONLINESUBSYSTEMPYTHON_API FOnlineAsyncTaskPythonMasterServer : public FOnlineAsyncTaskBasic<FOnlineSubsystemPython>
+{
+public:
+
+	/**
+	 * Builds the request URL and picks up the login token to send with it. Called on the game thread, the request itself is made from the online thread
+	 *
+	 * @param InSubsystem the subsystem the request is for
+	 * @param InRequestType the endpoint to call
+	 * @param Query url encoded query string including the leading '?', may be empty
+	 */
+	FOnlineAsyncTaskPythonMasterServer(FOnlineSubsystemPython* InSubsystem, EPythonRequest::Type InRequestType, const FString& Query);
+
+	virtual FString ToString() const override;
+
+	/** Issues the request, then waits for it and processes the response. Called on the online thread */
+	virtual void Tick() override;
+
+	/**
+	 * Backs off from the master server if it asked to, and has the identity log in again if the login token was rejected.
+	 * Subclasses write their results to the session interface after calling this
+	 */
+	virtual void Finalize() override;
+
+	/** Cancels the request, the task then completes as failed. Safe from any thread */
+	void Cancel();
+
+	/**
+	 * Completes the request with a response, as the HTTP module does when it arrives. Safe from any thread
+	 *
+	 * @param Response the response, null if there was none
+	 * @param bSucceeded whether the HTTP module got a response
+	 */
+	void SetResponse(FHttpResponsePtr Response, bool bSucceeded);
+
+protected:
+
+	/**
+	 * Turns a successful response into the results of the task. Called on the online thread
+	 *
+	 * @param JsonObject the response, with its error field false
+	 */
+	virtual void ProcessResponse(const FJsonObject& JsonObject) {}
+
+	/** @return the session interface the results are written to */
+	FOnlineSessionPythonPtr GetSessionInterface() const;
+
+	/**
+	 * Logs why the request failed the same way for every request
+	 *
+	 * @param Action what was being done, like "Creating Python Session"
+	 */
+	void LogFailure(const TCHAR* Action) const;
+
+	/** Endpoint called */
+	EPythonRequest::Type RequestType;
+
+	/** Whether the master server answered at all */
+	bool bGotResponse;
+
+	/** HTTP status of the answer, 0 if there was none */
+	int32 ResponseCode;
+
+	/** Whether the master server rejected the login token the request was sent with */
+	bool bAuthRejected;
+
+	/** Message the master server gave for failing the request */
+	FString ErrorMessage;
+
+private:
+
+	/** Completion of the request, shared with the HTTP module's delegate so it stays valid if the task goes first */
+	struct FRequestState
+	{
+		FHttpResponsePtr Response;
+		bool bSucceeded;
+
+		/** Seconds between issuing the request and it completing, negative if it was never issued */
+		double ElapsedTime;
+
+		/** Set last, once the fields above are written */
+		FThreadSafeBool bCompleted;
+
+		FRequestState() :
+			bSucceeded(false),
+			ElapsedTime(-1.0),
+			bCompleted(false)
+		{}
+	};
+
+	/** Sends the request, completing State from the HTTP thread */
+	void IssueRequest();
+
+	/** Parses the completed request and builds its results */
+	void ProcessCompletedRequest();
+
+	/** Full URL of the request */
+	FString URL;
+
+	/** Login token the request is authenticated with, empty to send it without one */
+	FString AuthToken;
+
+	/** The request once issued. Only used on the online thread */
+	FHttpRequestPtr Request;
+
+	TSharedRef<FRequestState, ESPMode::ThreadSafe> State;
+
+	/** Set by Cancel */
+	FThreadSafeBool bCancelRequested;
+
+	/** Whether Request has been cancelled */
+	bool bCancelled;
+
+	/** Seconds the master server asked us not to poll it for, 0 if it didn't */
+	int32 RetryAfterSeconds;
+};
+
+/**
+ * Registers the session being created with the master server, register_server
+ */
+class FOnlineAsyncTaskPythonRegisterServer : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param bInReregister whether the session already exists and the master server expired it, which doesn't fire OnCreateSessionComplete
+	 */
+	FOnlineAsyncTaskPythonRegisterServer(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FNamedSessionHandlePython& InSessionHandle, const FString& Query, bool bInReregister = false);
+
+	virtual void Finalize() override;
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** Name of the session being created */
+	FName SessionName;
+
+	/** The session being created, which may be destroyed before the master server answers */
+	FNamedSessionHandlePython SessionHandle;
+
+	/** Time between heartbeats, from the interval the master server expires servers after */
+	float HeartbeatDelta;
+
+	/** Whether the session was destroyed while it was being registered */
+	bool bSessionDestroyed;
+
+	/** Whether the session was registered before and the master server expired it */
+	bool bReregister;
+};
+
+/**
+ * Keeps the registered session listed, perform_heartbeat. Registers the session again if the master server no longer lists it
+ */
+class FOnlineAsyncTaskPythonHeartbeat : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InSessionHandle the registered session
+	 * @param Query query string with the session id and anything the heartbeat carries
+	 */
+	FOnlineAsyncTaskPythonHeartbeat(FOnlineSubsystemPython* InSubsystem, const FNamedSessionHandlePython& InSessionHandle, const FString& Query);
+
+	virtual void TriggerDelegates() override;
+
+private:
+
+	/** The registered session */
+	FNamedSessionHandlePython SessionHandle;
+};
+
+/**
+ * Updates a registered session's advertised settings, update_server
+ */
+class FOnlineAsyncTaskPythonUpdateServer : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param bInFromUpdateSession whether UpdateSession made the request, other updates don't fire OnUpdateSessionComplete
+	 */
+	FOnlineAsyncTaskPythonUpdateServer(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FString& Query, bool bInFromUpdateSession = true);
+
+	virtual void TriggerDelegates() override;
+
+private:
+
+	/** Name of the session being updated */
+	FName SessionName;
+
+	/** Whether UpdateSession made the request */
+	bool bFromUpdateSession;
+};
+
+/**
+ * Removes a destroyed session from the master server, unregister_server. The session itself is already gone locally
+ */
+class FOnlineAsyncTaskPythonUnregisterServer : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InCompletionDelegate delegate DestroySession was given, fired along with OnDestroySessionComplete
+	 */
+	FOnlineAsyncTaskPythonUnregisterServer(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FString& Query, const FOnDestroySessionCompleteDelegate& InCompletionDelegate);
+
+	virtual void TriggerDelegates() override;
+
+private:
+
+	/** Name of the session being destroyed */
+	FName SessionName;
+
+	/** Delegate DestroySession was given */
+	FOnDestroySessionCompleteDelegate CompletionDelegate;
+};
+
+/**
+ * Looks up a single server by session id, get_server
+ */
+class FOnlineAsyncTaskPythonGetServer : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InLocalUserNum the user searching, passed back to the delegate
+	 * @param SessionId id of the session to look up
+	 * @param InCompletionDelegate delegate FindSessionById was given
+	 */
+	FOnlineAsyncTaskPythonGetServer(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, const FUniqueNetIdPython& SessionId, const FOnSingleSessionResultCompleteDelegate& InCompletionDelegate);
+
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** The user searching */
+	int32 LocalUserNum;
+
+	/** Delegate FindSessionById was given */
+	FOnSingleSessionResultCompleteDelegate CompletionDelegate;
+
+	/** The server found */
+	FOnlineSessionSearchResult Result;
+
+	/** Whether the response had the server in it */
+	bool bFoundSession;
+};
+
+/**
+ * Finds the servers a list of players are on, find_friend_sessions
+ */
+class FOnlineAsyncTaskPythonFindFriendSessions : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InLocalUserNum the user searching, passed back to the delegates
+	 * @param Query query string listing the players to look up
+	 */
+	FOnlineAsyncTaskPythonFindFriendSessions(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, const FString& Query);
+
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** The user searching */
+	int32 LocalUserNum;
+
+	/** A result per server any of the players are on */
+	TArray<FOnlineSessionSearchResult> Results;
+};
+
+/**
+ * Has the master server pick a server for the searching players and hold their slots, matchmake. Joins the server it picks
+ */
+class FOnlineAsyncTaskPythonMatchmake : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InLocalUserNum the user joining the session
+	 * @param InSessionName name of the session to join
+	 * @param Query query string listing the players and what they are looking for
+	 */
+	FOnlineAsyncTaskPythonMatchmake(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, FName InSessionName, const FString& Query);
+
+	virtual void Finalize() override;
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** The user joining the session */
+	int32 LocalUserNum;
+
+	/** Name of the session to join */
+	FName SessionName;
+
+	/** The server picked */
+	FOnlineSessionSearchResult Result;
+
+	/** Whether the master server picked a server */
+	bool bFoundSession;
+
+	/** Whether matchmaking was cancelled before the response arrived */
+	bool bStale;
+};
+
+/**
+ * Holds a slot on a listed server for the player joining it, reserve_slots. Completes the join once the master server answers
+ */
+class FOnlineAsyncTaskPythonReserveSlot : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InSessionName name of the session being joined
+	 * @param InSessionHandle the session being joined, which may be destroyed before the master server answers
+	 * @param Query query string with the session id and the joining player
+	 */
+	FOnlineAsyncTaskPythonReserveSlot(FOnlineSubsystemPython* InSubsystem, FName InSessionName, const FNamedSessionHandlePython& InSessionHandle, const FString& Query);
+
+	virtual void Finalize() override;
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** Name of the session being joined */
+	FName SessionName;
+
+	/** The session being joined */
+	FNamedSessionHandlePython SessionHandle;
+
+	/** Whether the master server had no slot to hold */
+	bool bServerFull;
+
+	/** Whether the session was destroyed while the slot was being reserved */
+	bool bSessionDestroyed;
+};
+
+/**
+ * Finds a server with room for every member of a group and holds the leader's slot on it, group_join
+ */
+class FOnlineAsyncTaskPythonGroupJoin : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	/**
+	 * @param InLocalUserNum the user asking, passed back to the delegate
+	 * @param Query query string listing the members and the server or what to pick one by
+	 * @param InCompletionDelegate delegate FindGroupSession was given
+	 */
+	FOnlineAsyncTaskPythonGroupJoin(FOnlineSubsystemPython* InSubsystem, int32 InLocalUserNum, const FString& Query, const FOnSingleSessionResultCompleteDelegate& InCompletionDelegate);
+
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** The user asking */
+	int32 LocalUserNum;
+
+	/** Delegate FindGroupSession was given */
+	FOnSingleSessionResultCompleteDelegate CompletionDelegate;
+
+	/** The server the slots are held on */
+	FOnlineSessionSearchResult Result;
+
+	/** Whether the response had the server in it */
+	bool bFoundSession;
+};
+
+/**
+ * Gets the servers for the current search, get_serverlist. The results are built on the online thread and handed to the search in Finalize
+ */
+class ONLINESUBSYSTEMPYTHON_API FOnlineAsyncTaskPythonGetServerList : public FOnlineAsyncTaskPythonMasterServer
+{
+public:
+
+	explicit FOnlineAsyncTaskPythonGetServerList(FOnlineSubsystemPython* InSubsystem);
+
+	virtual void Finalize() override;
+	virtual void TriggerDelegates() override;
+
+protected:
+
+	virtual void ProcessResponse(const FJsonObject& JsonObject) override;
+
+private:
+
+	/** A result per server in the response */
+	TArray<FOnlineSessionSearchResult> Results;
+
+	/** Whether the search this was for was cancelled or timed out before the response arrived */
+	bool bStale;
+
+	/** Whether the search was a combined LAN and internet search, which completes once both halves have */
+	bool bHybridSearch;
+
+	/** Whether the search found sessions */
+	bool bFoundSessions;
+};
@@ -21,29 +21,72 @@ Permission is granted to anyone to use this software for any purpose, including
 #include "Interfaces/OnlineSessionInterface.h"
 #include "OnlineSubsystemPythonPackage.h"
 #include "LANBeacon.h"
+#include "OnlineRequestStatsPython.h"
+#include "NamedSessionLookupPython.h"
+#include "NamedSessionPoolPython.h"
+#include "SessionMembersPython.h"
 #include "Runtime/Online/HTTP/Public/Http.h"
 
 class FOnlineSubsystemPython;
 
+/**
+ * Delegate fired while a LAN search is in progress, at most once per tick, when new results have arrived
+ *
+ * @param FirstNewResult index in the search results of the first result added since the last call
+ * @param NumResults the number of search results so far
+ */
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnFindSessionsResultsUpdated, int32, int32);
+typedef FOnFindSessionsResultsUpdated::FDelegate FOnFindSessionsResultsUpdatedDelegate;
+
 /**
  * Interface definition for the online services session services 
  * Session services are defined as anything related managing a session 
  * and its state within a platform service
  */
-class FOnlineSessionPython : public IOnlineSession
+class ONLINESUBSYSTEMPYTHON_API FOnlineSessionPython : public IOnlineSession
 {
 private:
 
+	/** Headless benchmarks in the example project drive the private packet and response paths directly */
+	friend class FOnlineSessionPythonBenchmark;
+
+	/** Master server requests write their results back from the game thread once they complete */
+	friend class FOnlineAsyncTaskPythonMasterServer;
+	friend class FOnlineAsyncTaskPythonGetServerList;
+	friend class FOnlineAsyncTaskPythonMatchmake;
+	friend class FOnlineAsyncTaskPythonReserveSlot;
+	friend class FOnlineAsyncTaskPythonHeartbeat;
+
 	/** Reference to the main Python subsystem */
 	class FOnlineSubsystemPython* PythonSubsystem;
 
 	/** Handles advertising sessions over LAN and client searches */
 	FLANSession LANSessionManager;
 
+	/** Host address of the LAN response being decoded, reused so a rejected response allocates nothing */
+	TSharedPtr<class FInternetAddr> LANResponseHostAddr;
+
 	/** Hidden on purpose */
 	FOnlineSessionPython() :
 		PythonSubsystem(NULL),
-		CurrentSessionSearch(NULL)
+		MasterServerBackoffEndTime(0.0),
+		bPlayerCountPending(false),
+		PlayerCountPushTimeInSeconds(0),
+		bRegisterAwaitingLogin(false),
+		CurrentSessionSearch(NULL),
+		SessionSearchStartInSeconds(0),
+		LastLANResponseInSeconds(0),
+		LANResponseGapInSeconds(0),
+		NumLANResponses(0),
+		bLANResponseMoreFollows(false),
+		NumLANResultsNotified(0),
+		ServerListTask(nullptr),
+		MatchmakingTask(nullptr),
+		bHybridSearch(false),
+		bHybridLANPending(false),
+		bHybridInternetPending(false),
+		bHybridSearchSucceeded(false),
+		HybridSearchDeadlineInSeconds(0)
 	{}
 
 	/**
@@ -113,7 +156,24 @@ private:
 	 * @param Packet the writer object that will encode the data
 	 * @param Session the session to add to the packet
 	 */
-	void AppendSessionToPacket(class FNboSerializeToBufferNull& Packet, class FOnlineSession* Session);
+	void AppendSessionToPacket(class FNboSerializeToBufferNull& Packet, FNamedOnlineSession* Session);
+
+	/**
+	 * Gets the serialized session data sent in response to LAN queries, building and caching it if needed.
+	 * Must be called with SessionLock held.
+	 *
+	 * @param Session the session to get the payload for
+	 *
+	 * @return the payload, or null if it doesn't fit in a LAN packet
+	 */
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> GetLANPayload(FNamedOnlineSession& Session);
+
+	/**
+	 * Drops the cached LAN payload of a session, so the next LAN query re-serializes it
+	 *
+	 * @param SessionName the session whose advertised data changed
+	 */
+	void InvalidateLANPayload(FName SessionName);
 
 	/**
 	 * Adds the game settings data to the packet that is sent by the host
@@ -121,20 +181,22 @@ private:
 	 *
 	 * @param Packet the writer object that will encode the data
 	 * @param SessionSettings the session settings to add to the packet
+	 * @param RegisteredPlayerCount advertised as PLAYERCOUNT if the settings don't set it, INDEX_NONE to leave it out
 	 */
-	void AppendSessionSettingsToPacket(class FNboSerializeToBufferNull& Packet, FOnlineSessionSettings* SessionSettings);
+	void AppendSessionSettingsToPacket(class FNboSerializeToBufferNull& Packet, FOnlineSessionSettings* SessionSettings, int32 RegisteredPlayerCount = INDEX_NONE);
 
 	/**
-	 * Reads the settings data from the packet and applies it to the
-	 * specified object
+	 * Reads a session record from the packet and applies it to the
+	 * specified object. The owner id and session info are only set if the whole record decoded
 	 *
 	 * @param Packet the reader object that will read the data
-	 * @param SessionSettings the session settings to copy the data to
+	 * @param Session the session to copy the data to
+	 * @param bCompactSettings whether the settings use the compact layout or the fixed width one of older hosts
 	 */
-	void ReadSessionFromPacket(class FNboSerializeFromBufferNull& Packet, class FOnlineSession* Session);
+	void ReadSessionFromPacket(class FNboSerializeFromBufferNull& Packet, class FOnlineSession* Session, bool bCompactSettings = true);
 
 	/**
-	 * Reads the settings data from the packet and applies it to the
+	 * Reads the compact settings data written by AppendSessionSettingsToPacket and applies it to the
 	 * specified object
 	 *
 	 * @param Packet the reader object that will read the data
@@ -142,6 +204,14 @@ private:
 	 */
 	void ReadSettingsFromPacket(class FNboSerializeFromBufferNull& Packet, FOnlineSessionSettings& SessionSettings);
 
+	/**
+	 * Reads the fixed width settings data sent by hosts that answer with one session per packet
+	 *
+	 * @param Packet the reader object that will read the data
+	 * @param SessionSettings the session settings to copy the data to
+	 */
+	void ReadLegacySettingsFromPacket(class FNboSerializeFromBufferNull& Packet, FOnlineSessionSettings& SessionSettings);
+
 	/**
 	 * Delegate triggered when the LAN beacon has detected a valid client request has been received
 	 *
@@ -159,11 +229,68 @@ private:
 	 */
 	void OnValidResponsePacketReceived(uint8* PacketData, int32 PacketLength);
 
+	/**
+	 * Decodes a single session record of a host response and adds it to the current search results
+	 *
+	 * @param RecordData the session record, either a whole legacy response or one record of a packed response
+	 * @param RecordLength length of the record
+	 * @param bCompactSettings whether the record uses the compact settings layout
+	 */
+	void AddSearchResultFromPacket(uint8* RecordData, int32 RecordLength, bool bCompactSettings);
+
 	/**
 	 * Delegate triggered when the LAN beacon has finished searching (some time after last received host packet)
 	 */
 	void OnLANSearchTimeout();
 
+	/**
+	 * Records a host response arriving, for working out when the responses have gone quiet
+	 *
+	 * @param bMoreFollows whether the host said it is sending further packets for the query
+	 */
+	void RecordLANResponseArrival(bool bMoreFollows);
+
+	/**
+	 * @return how long the current LAN search waits after the last response before finishing
+	 */
+	double GetLANSearchQuietWindow() const;
+
+	/**
+	 * Passes new results of the current LAN search to the incremental delegate, and finishes the search early once hosts stop answering
+	 */
+	void TickLANSearch();
+
+	/**
+	 * Starts a LAN search and a master server query for the current search at the same time
+	 *
+	 * @return ONLINE_IO_PENDING if either started, an error code otherwise
+	 */
+	uint32 FindHybridSessions();
+
+	/**
+	 * Completes the current combined search with whatever it has once its deadline has passed
+	 */
+	void TickHybridSearch();
+
+	/**
+	 * Completes the current combined search if neither the LAN nor the master server half is still running
+	 */
+	void TryCompleteHybridSearch();
+
+	/**
+	 * Cancels the outstanding get_serverlist request, its response will be ignored
+	 */
+	void CancelServerListRequest();
+
+	/**
+	 * Adds a result to the current search. A combined search merges results for a host it already has,
+	 * matched by session id or host address, keeping the LAN result over the master server one.
+	 *
+	 * @param Result the result to add
+	 * @param bFromLAN whether the result came from a LAN host response
+	 */
+	void AddSearchResult(FOnlineSessionSearchResult&& Result, bool bFromLAN);
+
 	/**
 	 * Attempt to set the host port in the session info based on the actual port the netdriver is using.
 	 */
@@ -174,13 +301,143 @@ private:
 	 */
 	bool IsHost(const FNamedOnlineSession& Session) const;
 
+	/**
+	 * @return the PLAYERCOUNT the game set on a hosted session, otherwise the number of players registered in it
+	 */
+	int32 GetAdvertisedPlayerCount(const FNamedOnlineSession& Session) const;
+
+	/**
+	 * Builds the update_server query advertising a session's current settings and player count
+	 *
+	 * @param Session the session to advertise
+	 *
+	 * @return url encoded query string including the leading '?'
+	 */
+	FString MakeUpdateServerQuery(const FNamedOnlineSession& Session) const;
+
+	/**
+	 * Lists a session's registered players for the master server, which indexes them so friends can find the session
+	 *
+	 * @param Session the session to list the players of
+	 *
+	 * @return comma separated player ids
+	 */
+	FString MakePlayersQueryValue(const FNamedOnlineSession& Session) const;
+
+	/**
+	 * Looks up the sessions a list of friends are in with a single master server request
+	 *
+	 * @param LocalUserNum the user searching
+	 * @param FriendList the friends to look for, only Python ids can be found
+	 *
+	 * @return true if the request was sent, OnFindFriendSessionComplete fires either way
+	 */
+	bool FindFriendSessions(int32 LocalUserNum, const TArray<TSharedRef<const FUniqueNetId>>& FriendList);
+
+	/**
+	 * @param UserId a local user's id
+	 *
+	 * @return the local user's index, 0 if the id isn't a local user's
+	 */
+	int32 GetLocalUserNum(const FUniqueNetId& UserId) const;
+
+	/**
+	 * Registers and unregisters players in one pass over the session's membership, without triggering delegates
+	 *
+	 * @param SessionName name of the session
+	 * @param Joining players to register
+	 * @param Leaving players to unregister, removed before Joining is added
+	 *
+	 * @return true if the session exists
+	 */
+	bool ApplyPlayerChanges(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Joining, const TArray< TSharedRef<const FUniqueNetId> >& Leaving);
+
+	/**
+	 * Schedules sending the registered player count of the hosted internet session to the master server a little later,
+	 * together with any other changes made in the meantime
+	 *
+	 * @param Session the session whose registered players changed
+	 */
+	void PushPlayerCount(FNamedOnlineSession& Session);
+
+	/**
+	 * Sends a pending player count once it is due, unless the next heartbeat is close enough to carry it
+	 */
+	void TickPlayerCountPush();
+
+	/**
+	 * @return seconds until the next heartbeat, negative if none is scheduled
+	 */
+	float GetHeartbeatTimeRemaining() const;
+
+	/**
+	 * Queues a master server request on the online thread, which issues it and processes its response
+	 *
+	 * @param Task the request, deleted by the task manager once it completes
+	 */
+	void QueueMasterServerRequest(class FOnlineAsyncTaskPythonMasterServer* Task);
+
+	/**
+	 * Checks whether the master server asked us to back off with a 429 and the Retry-After time hasn't passed
+	 *
+	 * @return true if polling requests should not be sent yet
+	 */
+	bool IsBackingOffFromMasterServer() const;
+
+	/** Time (FPlatformTime::Seconds) until which the master server asked us not to poll it */
+	double MasterServerBackoffEndTime;
+
+	/** Whether the registered session's player count changed since it was last sent to the master server */
+	bool bPlayerCountPending;
+
+	/** Time (FPlatformTime::Seconds) the pending player count is sent if no heartbeat has taken it by then */
+	double PlayerCountPushTimeInSeconds;
+
+	/**
+	 * Sends register_server for the session being created
+	 *
+	 * @param Session the session being created, CreateSessionHandle resolves to it
+	 * @param bReregister whether the session is already registered and the master server expired it
+	 */
+	void QueueRegisterServer(FNamedOnlineSession& Session, bool bReregister = false);
+
+	/**
+	 * Registers the session being created once the hosting player's master server login has completed or timed out
+	 */
+	void TickRegisterAwaitingLogin();
+
+	/** Whether the session being created waits on the host's master server login, register_server needs its token */
+	bool bRegisterAwaitingLogin;
+
 PACKAGE_SCOPE:
 
 	/** Critical sections for thread safe operation of session lists */
 	mutable FCriticalSection SessionLock;
 
-	/** Current session settings */
-	TArray<FNamedOnlineSession> Sessions;
+	/** Current session settings, at addresses that are stable until the session is removed */
+	FNamedSessionPoolPython Sessions;
+
+	/** Lookup of Sessions by name that can be read without SessionLock, republished whenever Sessions or a session's state changes */
+	FNamedSessionLookupPython SessionLookup;
+
+	/**
+	 * Changes the state of a session and republishes the session lookup, so GetSessionState sees the new state
+	 *
+	 * @param Session the session to change
+	 * @param State the state it is now in
+	 */
+	void SetSessionState(FNamedOnlineSession& Session, EOnlineSessionState::Type State)
+	{
+		FScopeLock ScopeLock(&SessionLock);
+		Session.SessionState = State;
+		SessionLookup.Publish(Sessions);
+	}
+
+	/** Hashed membership of each session with registered players, by session name. Only used on the game thread */
+	TMap<FName, FSessionMembersPython> SessionMembers;
+
+	/** Serialized session data answered to LAN queries, by session name. Protected by SessionLock */
+	TMap<FName, TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>> LANPayloads;
 
 	/** Current search object */
 	TSharedPtr<FOnlineSessionSearch> CurrentSessionSearch;
@@ -188,10 +445,75 @@ PACKAGE_SCOPE:
 	/** Current search start time. */
 	double SessionSearchStartInSeconds;
 
+	/** Time the last host response of the current LAN search arrived */
+	double LastLANResponseInSeconds;
+
+	/** Smoothed time between host responses of the current LAN search */
+	double LANResponseGapInSeconds;
+
+	/** Number of host responses the current LAN search has received */
+	int32 NumLANResponses;
+
+	/** Whether the last host response said more packets follow */
+	bool bLANResponseMoreFollows;
+
+	/** Number of results of the current LAN search the incremental delegate has been told about */
+	int32 NumLANResultsNotified;
+
+	/** Outstanding get_serverlist request of the current search, owned by the async task manager */
+	class FOnlineAsyncTaskPythonGetServerList* ServerListTask;
+
+	/** Outstanding matchmake request, owned by the async task manager */
+	class FOnlineAsyncTaskPythonMatchmake* MatchmakingTask;
+
+	/** Session the outstanding matchmake request joins */
+	FName MatchmakingSessionName;
+
+	/** Search the outstanding matchmake request fills in */
+	TSharedPtr<FOnlineSessionSearch> MatchmakingSearch;
+
+	/** Whether the current search is searching LAN and the master server at once */
+	bool bHybridSearch;
+
+	/** Whether the LAN half of the combined search is still running */
+	bool bHybridLANPending;
+
+	/** Whether the master server half of the combined search is still running */
+	bool bHybridInternetPending;
+
+	/** Whether either half of the combined search succeeded */
+	bool bHybridSearchSucceeded;
+
+	/** Time the combined search completes even if a half is still running */
+	double HybridSearchDeadlineInSeconds;
+
+	/** Index in the search results of every host of the combined search, by session id and by address */
+	TMap<FUniqueNetIdPython, int32> HybridResultsBySessionId;
+	TMap<FString, int32> HybridResultsByHostAddr;
+
+	/** Whether each result of the combined search came from LAN */
+	TArray<bool> HybridResultFromLAN;
+
 	FOnlineSessionPython(class FOnlineSubsystemPython* InSubsystem) :
 		PythonSubsystem(InSubsystem),
+		MasterServerBackoffEndTime(0.0),
+		bPlayerCountPending(false),
+		PlayerCountPushTimeInSeconds(0),
+		bRegisterAwaitingLogin(false),
 		CurrentSessionSearch(NULL),
-		SessionSearchStartInSeconds(0)
+		SessionSearchStartInSeconds(0),
+		LastLANResponseInSeconds(0),
+		LANResponseGapInSeconds(0),
+		NumLANResponses(0),
+		bLANResponseMoreFollows(false),
+		NumLANResultsNotified(0),
+		ServerListTask(nullptr),
+		MatchmakingTask(nullptr),
+		bHybridSearch(false),
+		bHybridLANPending(false),
+		bHybridInternetPending(false),
+		bHybridSearchSucceeded(false),
+		HybridSearchDeadlineInSeconds(0)
 	{}
 
 	/**
@@ -203,13 +525,44 @@ PACKAGE_SCOPE:
 	class FNamedOnlineSession* AddNamedSession(FName SessionName, const FOnlineSessionSettings& SessionSettings) override
 	{
 		FScopeLock ScopeLock(&SessionLock);
-		return new (Sessions) FNamedOnlineSession(SessionName, SessionSettings);
+		FNamedOnlineSession* NewSession = Sessions.Emplace(SessionName, SessionSettings);
+		SessionLookup.Publish(Sessions);
+		return NewSession;
 	}
 
 	class FNamedOnlineSession* AddNamedSession(FName SessionName, const FOnlineSession& Session) override
 	{
 		FScopeLock ScopeLock(&SessionLock);
-		return new (Sessions) FNamedOnlineSession(SessionName, Session);
+		FNamedOnlineSession* NewSession = Sessions.Emplace(SessionName, Session);
+		SessionLookup.Publish(Sessions);
+		return NewSession;
+	}
+
+	/**
+	 * Gets a handle for async work to find its session again once it completes, without a name lookup.
+	 * Unlike the name, the handle won't find a different session created under the same name in the meantime.
+	 *
+	 * @param Session the session to refer to
+	 *
+	 * @return handle to the session
+	 */
+	FNamedSessionHandlePython GetSessionHandle(const FNamedOnlineSession* Session) const
+	{
+		FScopeLock ScopeLock(&SessionLock);
+		return Sessions.GetHandle(Session);
+	}
+
+	/**
+	 * Finds the session a handle was taken from
+	 *
+	 * @param Handle handle from GetSessionHandle
+	 *
+	 * @return the session, or null if it has been destroyed
+	 */
+	FNamedOnlineSession* ResolveSessionHandle(const FNamedSessionHandlePython& Handle) const
+	{
+		FScopeLock ScopeLock(&SessionLock);
+		return Sessions.Resolve(Handle);
 	}
 
 	/**
@@ -238,14 +591,52 @@ PACKAGE_SCOPE:
 	 */
 	void RegisterLocalPlayers(class FNamedOnlineSession* Session);
 
+	/**
+	 * Joins a session, first holding a slot on it with the master server if it was listed there
+	 *
+	 * @param PlayerNum local index of the user joining
+	 * @param SessionName name of the session to join
+	 * @param DesiredSession the session to join
+	 * @param bReserveSlot whether to hold a slot first, matchmaking already holds one
+	 *
+	 * @return true if the join completed or is waiting on the master server
+	 */
+	bool JoinPythonSession(int32 PlayerNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession, bool bReserveSlot);
+
+	/**
+	 * Has the master server hold a slot for every member of a group on one server, see FOnlineSubsystemPython::FindGroupSession
+	 *
+	 * @param LocalUserNum the user asking, passed back to the delegate
+	 * @param GroupMembers everyone in the group, including the user asking
+	 * @param SearchSettings game mode, map and region to pick a server by, null to pick from every server
+	 * @param DesiredSession server to hold the slots on, null to have the master server pick one
+	 * @param CompletionDelegate fired with the server the slots are held on
+	 *
+	 * @return true if the request was sent
+	 */
+	bool FindGroupSession(int32 LocalUserNum, const TArray<TSharedRef<const FUniqueNetId>>& GroupMembers, const FOnlineSessionSearch* SearchSettings, const FOnlineSessionSearchResult* DesiredSession, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate);
+
 public:
 
 	virtual ~FOnlineSessionPython() {}
 
+	/**
+	 * Delegate fired as results of a LAN search arrive, before OnFindSessionsComplete.
+	 * The results so far are in the search settings passed to FindSessions.
+	 */
+	DEFINE_ONLINE_DELEGATE_TWO_PARAM(OnFindSessionsResultsUpdated, int32, int32);
+
 	virtual TSharedPtr<const FUniqueNetId> CreateSessionIdFromString(const FString& SessionIdStr) override;
 
 	FNamedOnlineSession* GetNamedSession(FName SessionName) override
 	{
+		FNamedOnlineSession* FoundSession = nullptr;
+		EOnlineSessionState::Type FoundState;
+		if (SessionLookup.Find(SessionName, FoundSession, FoundState))
+		{
+			return FoundSession;
+		}
+
 		FScopeLock ScopeLock(&SessionLock);
 		for (int32 SearchIndex = 0; SearchIndex < Sessions.Num(); SearchIndex++)
 		{
@@ -260,11 +651,14 @@ public:
 	virtual void RemoveNamedSession(FName SessionName) override
 	{
 		FScopeLock ScopeLock(&SessionLock);
+		LANPayloads.Remove(SessionName);
+		SessionMembers.Remove(SessionName);
 		for (int32 SearchIndex = 0; SearchIndex < Sessions.Num(); SearchIndex++)
 		{
 			if (Sessions[SearchIndex].SessionName == SessionName)
 			{
-				Sessions.RemoveAtSwap(SearchIndex);
+				Sessions.RemoveAt(SearchIndex);
+				SessionLookup.Publish(Sessions);
 				return;
 			}
 		}
@@ -272,6 +666,13 @@ public:
 
 	virtual EOnlineSessionState::Type GetSessionState(FName SessionName) const override
 	{
+		FNamedOnlineSession* FoundSession = nullptr;
+		EOnlineSessionState::Type FoundState = EOnlineSessionState::NoSession;
+		if (SessionLookup.Find(SessionName, FoundSession, FoundState))
+		{
+			return FoundState;
+		}
+
 		FScopeLock ScopeLock(&SessionLock);
 		for (int32 SearchIndex = 0; SearchIndex < Sessions.Num(); SearchIndex++)
 		{
@@ -286,29 +687,19 @@ public:
 
 	virtual bool HasPresenceSession() override
 	{
-		FScopeLock ScopeLock(&SessionLock);
-		for (int32 SearchIndex = 0; SearchIndex < Sessions.Num(); SearchIndex++)
-		{
-			if (Sessions[SearchIndex].SessionSettings.bUsesPresence)
-			{
-				return true;
-			}
-		}
-		
-		return false;
+		return SessionLookup.HasPresenceSession();
 	}
 
 	// IOnlineSession
 	virtual bool CreateSession(int32 HostingPlayerNum, FName SessionName, const FOnlineSessionSettings& NewSessionSettings) override;
 	virtual bool CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings) override;
 	FName CreateSessionName;
-	void CreateSession_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful);
+	/** Session being registered with the master server and kept alive by the heartbeat */
+	FNamedSessionHandlePython CreateSessionHandle;
 	virtual bool StartSession(FName SessionName) override;
 	virtual bool UpdateSession(FName SessionName, FOnlineSessionSettings& UpdatedSessionSettings, bool bShouldRefreshOnlineData = true) override;
-	void UpdateSession_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful);
 	virtual bool EndSession(FName SessionName) override;
 	virtual bool DestroySession(FName SessionName, const FOnDestroySessionCompleteDelegate& CompletionDelegate = FOnDestroySessionCompleteDelegate()) override;
-	void DestroySession_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful);
 	virtual bool IsPlayerInSession(FName SessionName, const FUniqueNetId& UniqueId) override;
 	virtual bool StartMatchmaking(const TArray< TSharedRef<const FUniqueNetId> >& LocalPlayers, FName SessionName, const FOnlineSessionSettings& NewSessionSettings, TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
 	virtual bool CancelMatchmaking(int32 SearchingPlayerNum, FName SessionName) override;
@@ -316,7 +707,6 @@ public:
 	virtual bool FindSessions(int32 SearchingPlayerNum, const TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
 	virtual bool FindSessions(const FUniqueNetId& SearchingPlayerId, const TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
 	virtual bool FindSessionById(const FUniqueNetId& SearchingUserId, const FUniqueNetId& SessionId, const FUniqueNetId& FriendId, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate) override;
-	void FindSessions_ResponseReceived(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful);
 	virtual bool CancelFindSessions() override;
 	virtual bool PingSearchResults(const FOnlineSessionSearchResult& SearchResult) override;
 	virtual bool JoinSession(int32 PlayerNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession) override;
@@ -335,12 +725,29 @@ public:
 	virtual bool RegisterPlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Players, bool bWasInvited = false) override;
 	virtual bool UnregisterPlayer(FName SessionName, const FUniqueNetId& PlayerId) override;
 	virtual bool UnregisterPlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Players) override;
+
+	/**
+	 * Registers and unregisters players of a session in one pass, as when a batch of players joins and leaves a server.
+	 * Leaving players are removed before joining players are added. Fires the unregister delegate if any players leave
+	 * and the register delegate if any join. A hosted internet session's new player count goes to the master server shortly
+	 * after, together with any other changes in the meantime, on the next heartbeat if one is nearly due.
+	 *
+	 * @param SessionName name of the session
+	 * @param Joining players to register
+	 * @param Leaving players to unregister
+	 * @param bWasInvited whether the joining players were invited
+	 *
+	 * @return true if the session exists
+	 */
+	bool UpdatePlayers(FName SessionName, const TArray< TSharedRef<const FUniqueNetId> >& Joining, const TArray< TSharedRef<const FUniqueNetId> >& Leaving, bool bWasInvited = false);
+
 	virtual void RegisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate) override;
 	virtual void UnregisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnUnregisterLocalPlayerCompleteDelegate& Delegate) override;
 	virtual int32 GetNumSessions() override;
 	virtual void DumpSessionState() override;
 
 	void StartHeartbeat(float DeltaBetweenHeartbeats);
+	void StopHeartbeat();
 	FTimerHandle PerformHeartbeat_Handle;
 	void PerformHeartbeat();
 };
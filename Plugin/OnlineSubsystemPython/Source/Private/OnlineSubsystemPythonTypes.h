@@ -15,13 +15,133 @@ Permission is granted to anyone to use this software for any purpose, including
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Misc/Guid.h"
 #include "OnlineSubsystemTypes.h"
 #include "IPAddress.h"
 
 class FOnlineSubsystemPython;
 
-// from OnlineSubsystemTypes.h
-TEMP_UNIQUENETIDSTRING_SUBCLASS(FUniqueNetIdPython, "Python");
+/**
+ * Unique id of a Python player or session, held as 128 bits with its hash worked out up front, so map lookups and
+ * comparisons never touch a string.
+ *
+ * Ids are written as 32 hex digits for display and on the wire, and read back from that exactly. Any other string, like an
+ * id from an older build, is mapped onto 128 bits by its MD5, so the same string always gives the same id.
+ */
+class FUniqueNetIdPython : public FUniqueNetId
+{
+public:
+
+	/** Size of the binary form, as returned by GetBytes */
+	static const int32 IdSize = sizeof(FGuid);
+
+	/** Makes an invalid, all zero id */
+	FUniqueNetIdPython() :
+		Hash(GetTypeHash(Guid))
+	{}
+
+	explicit FUniqueNetIdPython(const FGuid& InGuid) :
+		Guid(InGuid),
+		Hash(GetTypeHash(InGuid))
+	{}
+
+	/**
+	 * @param Str id as returned by ToString, or any other string to map onto an id
+	 */
+	explicit FUniqueNetIdPython(const FString& Str);
+
+	/**
+	 * @param Src id of any type, converted through its string unless it is a Python id
+	 */
+	explicit FUniqueNetIdPython(const FUniqueNetId& Src);
+
+	/**
+	 * Reads the binary form returned by GetBytes
+	 *
+	 * @param InBytes IdSize bytes
+	 */
+	explicit FUniqueNetIdPython(const uint8* InBytes);
+
+	/** @return the type every Python id has */
+	static FName GetTypeName()
+	{
+		static const FName TypeName(TEXT("Python"));
+		return TypeName;
+	}
+
+	// FUniqueNetId
+
+	virtual FName GetType() const override
+	{
+		return GetTypeName();
+	}
+
+	virtual const uint8* GetBytes() const override
+	{
+		return reinterpret_cast<const uint8*>(&Guid);
+	}
+
+	virtual int32 GetSize() const override
+	{
+		return IdSize;
+	}
+
+	virtual bool IsValid() const override
+	{
+		return Guid.IsValid();
+	}
+
+	virtual FString ToString() const override
+	{
+		return Guid.ToString(EGuidFormats::Digits);
+	}
+
+	virtual FString ToDebugString() const override
+	{
+		return ToString();
+	}
+
+	virtual bool Compare(const FUniqueNetId& Other) const override
+	{
+		if (Other.GetType() != GetTypeName())
+		{
+			return false;
+		}
+		const FUniqueNetIdPython& OtherPython = static_cast<const FUniqueNetIdPython&>(Other);
+		return Hash == OtherPython.Hash && Guid == OtherPython.Guid;
+	}
+
+	// FUniqueNetIdPython
+
+	/** @return hash of the id, computed when it was made */
+	uint32 GetHash() const
+	{
+		return Hash;
+	}
+
+	bool operator==(const FUniqueNetIdPython& Other) const
+	{
+		return Hash == Other.Hash && Guid == Other.Guid;
+	}
+
+	bool operator!=(const FUniqueNetIdPython& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	friend uint32 GetTypeHash(const FUniqueNetIdPython& Id)
+	{
+		return Id.Hash;
+	}
+
+private:
+
+	/** The 128 bits of the id */
+	FGuid Guid;
+
+	/** Hash of Guid */
+	uint32 Hash;
+};
 
 /** 
  * Implementation of session information
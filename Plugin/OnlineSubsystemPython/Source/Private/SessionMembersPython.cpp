@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2019 Ryan Post
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SessionMembersPython.h"
+#include "OnlineSessionSettings.h"
+
+void FSessionMembersPython::Sync(const FNamedOnlineSession& Session)
+{
+	if (PlayerIndices.Num() == Session.RegisteredPlayers.Num())
+	{
+		return;
+	}
+
+	PlayerIndices.Reset();
+	PlayerIndices.Reserve(Session.RegisteredPlayers.Num());
+	for (int32 PlayerIndex = 0; PlayerIndex < Session.RegisteredPlayers.Num(); PlayerIndex++)
+	{
+		PlayerIndices.Add(FSessionMemberKeyPython(Session.RegisteredPlayers[PlayerIndex]), PlayerIndex);
+	}
+}
+
+int32 FSessionMembersPython::Find(const FNamedOnlineSession& Session, const FUniqueNetId& PlayerId)
+{
+	Sync(Session);
+
+	const int32* PlayerIndex = PlayerIndices.Find(FSessionMemberKeyPython(PlayerId));
+	return PlayerIndex ? *PlayerIndex : INDEX_NONE;
+}
+
+void FSessionMembersPython::Add(FNamedOnlineSession& Session, const TSharedRef<const FUniqueNetId>& PlayerId)
+{
+	Sync(Session);
+
+	const int32 PlayerIndex = Session.RegisteredPlayers.Add(PlayerId);
+	PlayerIndices.Add(FSessionMemberKeyPython(PlayerId), PlayerIndex);
+}
+
+void FSessionMembersPython::RemoveAtSwap(FNamedOnlineSession& Session, int32 PlayerIndex)
+{
+	Sync(Session);
+
+	TArray< TSharedRef<const FUniqueNetId> >& RegisteredPlayers = Session.RegisteredPlayers;
+	PlayerIndices.Remove(FSessionMemberKeyPython(*RegisteredPlayers[PlayerIndex]));
+
+	const int32 LastIndex = RegisteredPlayers.Num() - 1;
+	if (PlayerIndex != LastIndex)
+	{
+		// The last player is about to be moved into the removed player's slot
+		PlayerIndices.Add(FSessionMemberKeyPython(RegisteredPlayers[LastIndex]), PlayerIndex);
+	}
+	RegisteredPlayers.RemoveAtSwap(PlayerIndex);
+}
@@ -13,14 +13,80 @@ from cherrypy.lib import auth_digest
 from cherrypy import response
 import json
 import jsonpickle
+import os
+import re
 import time
 from time import sleep
-from threading import Thread
+from threading import Thread, Lock
 import requests
+from collections import namedtuple
+from metrics import Registry, CONTENT_TYPE
+from ratelimit import AdmissionControl, EndpointLimit
+from auth import TokenSigner, new_account_id
+from uuid import uuid4
+
+# Per endpoint admission limits: requests per second and burst allowed per client IP, and requests handled at once across all clients.
+# Endpoints without an entry are never limited. Several game servers behind one IP share a bucket, so heartbeat and update limits are generous.
+RATE_LIMITS = {
+    'register_server' : EndpointLimit(rate=0.5, burst=10, max_concurrent=20),
+    'update_server' : EndpointLimit(rate=5, burst=20, max_concurrent=30),
+    'unregister_server' : EndpointLimit(rate=5, burst=20, max_concurrent=20),
+    'perform_heartbeat' : EndpointLimit(rate=5, burst=20, max_concurrent=30),
+    'get_serverlist' : EndpointLimit(rate=1, burst=5, max_concurrent=40),
+    'get_server' : EndpointLimit(rate=5, burst=20, max_concurrent=40),
+    'find_friend_sessions' : EndpointLimit(rate=1, burst=10, max_concurrent=40),
+    'matchmake' : EndpointLimit(rate=1, burst=5, max_concurrent=40),
+    'reserve_slots' : EndpointLimit(rate=1, burst=10, max_concurrent=40),
+    'group_join' : EndpointLimit(rate=1, burst=5, max_concurrent=40),
+    'login' : EndpointLimit(rate=0.5, burst=10, max_concurrent=20),
+}
+
+# Client IPs that bypass the per IP limits, e.g. a load test running on the same machine
+RATE_LIMIT_EXEMPT_IPS = ()
+
+# Key login tokens are signed with. Set it so tokens survive a restart and several master servers accept each other's tokens,
+# otherwise a random key is made at startup and clients log in again when their token is rejected.
+AUTH_SECRET = os.environ.get('MASTERSERVER_AUTH_SECRET', '').encode('utf-8') or os.urandom(32)
+
+# Seconds a login token is valid for. An expired token can be swapped for a new one on the same account at /login for as long again.
+AUTH_TOKEN_LIFETIME = 24 * 60 * 60
+
+# AuthorizationTicket values the plugin may log in with, empty to let anyone log in
+AUTHORIZATION_TICKETS = ()
+
+# Endpoints that change the server list or hold slots on it, and need a login token in an "Authorization: Bearer" header.
+# A server can only be changed with a token for the account that registered it.
+AUTHENTICATED_ENDPOINTS = ('register_server', 'update_server', 'unregister_server', 'perform_heartbeat', 'matchmake', 'reserve_slots', 'group_join')
+
+# Seconds a slot handed out by matchmake, reserve_slots or group_join is held for a player before it is offered to someone else.
+# The hold ends early once the server lists the player among its registered players.
+RESERVATION_LIFETIME = 30
+
+# Most players one matchmake, reserve_slots or group_join request can hold slots for
+MAX_MATCHMAKING_PLAYERS = 16
+
+# Most slots one account can hold at once across all servers, enough for its own player and a small party.
+# Players the account holds again move to the new server rather than holding a second slot
+MAX_HOLDS_PER_ACCOUNT = 8
+
+# Most slots held at once by requests from one client IP, so logging in throwaway accounts doesn't get around
+# MAX_HOLDS_PER_ACCOUNT. Clients in RATE_LIMIT_EXEMPT_IPS aren't capped
+MAX_HOLDS_PER_IP = 32
+
+# How much each criterion counts when matchmake scores a server. Fill is the fraction of the server in use,
+# region and map add their weight when they match the request.
+MATCHMAKING_FILL_WEIGHT = 1.0
+MATCHMAKING_REGION_WEIGHT = 2.0
+MATCHMAKING_MAP_WEIGHT = 0.5
+
+# A slot held on a server for a player: when the hold ends, and the account and client IP that asked for it
+Hold = namedtuple('Hold', ('expires', 'account', 'ip'))
 
 class Server(object):
      def __init__(self):
-        self.registeredby = ''
+        # Session id the plugin generated for the session, the key the server is listed and looked up under
+        self.id = ''
+        self.ip = ''
         self.name = ''
         self.port = 0
         self.map = ''
@@ -29,114 +95,685 @@ class Server(object):
         self.pwprotected = False
         self.gamemode = ''
         self.timeoflastheartbeat = 0
+        # Account whose login token registered the server
+        self.owner = None
+        # Ids of the players registered in the session, indexed for friend lookups
+        self.players = frozenset()
+        # Region the host advertises, matched against the region players ask matchmake for
+        self.region = ''
+        # Slots held for players who haven't joined yet, a Hold by player id. Replaced, never changed in place
+        self.reservations = {}
 		
      def __eq__(self, other):
         if isinstance(other, self.__class__):
-            return self.name== other.name and self.port == other.port
+            return self.id == other.id
         else:
             return False
 
+# Most players a server can list for friend lookups, and most players one find_friend_sessions request can ask about
+MAX_PLAYERS_PER_SERVER = 1000
+MAX_FRIENDS_PER_LOOKUP = 100
+
+# Session ids and player ids are GUIDs written as 32 hex digits
+ID_PATTERN = re.compile('^[0-9a-f]{32}$')
+
+def normalize_id(id):
+    """Returns id in the form servers and players are keyed on, None if it isn't a GUID"""
+    if not id:
+        return None
+    id = id.strip().lower()
+    return id if ID_PATTERN.match(id) else None
+
+def normalize_player_ids(players, limit):
+    """Returns the distinct valid ids in a comma separated list, at most limit of them"""
+    ids = []
+    seen = set()
+    for player in players.split(','):
+        player = normalize_id(player)
+        if player is not None and player not in seen:
+            seen.add(player)
+            ids.append(player)
+            if len(ids) >= limit:
+                break
+    return ids
+
+class RequestMetricsTool(cherrypy.Tool):
+    """Times every request and keeps the per endpoint request and in-flight counts up to date"""
+
+    def __init__(self, masterserver):
+        self.masterserver = masterserver
+        cherrypy.Tool.__init__(self, 'on_start_resource', self.start_request, priority=5)
+
+    def _setup(self):
+        cherrypy.Tool._setup(self)
+        cherrypy.request.hooks.attach('on_end_request', self.end_request)
+
+    def start_request(self):
+        request = cherrypy.request
+        request.metrics_endpoint = self.masterserver.endpoint_label(request.path_info)
+        request.metrics_start = time.perf_counter()
+        self.masterserver.requests_in_flight.inc(endpoint=request.metrics_endpoint)
+
+    def end_request(self):
+        request = cherrypy.request
+        if not hasattr(request, 'metrics_start'):
+            return
+        endpoint = request.metrics_endpoint
+        self.masterserver.requests_in_flight.dec(endpoint=endpoint)
+        self.masterserver.request_duration.observe(time.perf_counter() - request.metrics_start, endpoint=endpoint)
+        self.masterserver.requests_total.inc(endpoint=endpoint, code=str(cherrypy.response.status).split(' ')[0])
+
+class AdmissionControlTool(cherrypy.Tool):
+    """Rejects requests over their per IP rate or per endpoint concurrency limit with a 429 before the handler runs"""
+
+    def __init__(self, masterserver):
+        self.masterserver = masterserver
+        # Runs after the metrics tool so rejected requests are still counted and timed
+        cherrypy.Tool.__init__(self, 'on_start_resource', self.admit_request, priority=10)
+
+    def _setup(self):
+        cherrypy.Tool._setup(self)
+        cherrypy.request.hooks.attach('on_end_request', self.release_request)
+
+    def admit_request(self):
+        request = cherrypy.request
+        endpoint = self.masterserver.endpoint_label(request.path_info)
+        reason, retry_after = self.masterserver.admission.admit(request.remote.ip, endpoint)
+        if reason is None:
+            request.admitted_endpoint = endpoint
+            return
+        self.masterserver.rejected_requests.inc(endpoint=endpoint, reason=reason)
+        # Skip the handler entirely, the rejection is a static body so no JSON work is done
+        request.handler = None
+        cherrypy.response.status = 429
+        cherrypy.response.headers['Retry-After'] = str(retry_after)
+        cherrypy.response.headers['Content-Type'] = 'application/json'
+        cherrypy.response.body = [b'{"error": true, "message": "Too many requests"}']
+
+    def release_request(self):
+        request = cherrypy.request
+        if hasattr(request, 'admitted_endpoint'):
+            self.masterserver.admission.release(request.admitted_endpoint)
+
+class AuthTool(cherrypy.Tool):
+    """Checks the login token of requests to endpoints that change the server list, rejecting them with a 401 before the handler runs"""
+
+    def __init__(self, masterserver):
+        self.masterserver = masterserver
+        # Runs after admission control so requests turned away for load cost no signature check
+        cherrypy.Tool.__init__(self, 'on_start_resource', self.authenticate_request, priority=20)
+
+    def authenticate_request(self):
+        request = cherrypy.request
+        request.account_id = None
+        request.player_id = None
+        endpoint = self.masterserver.endpoint_label(request.path_info)
+        if endpoint not in AUTHENTICATED_ENDPOINTS:
+            return
+
+        reason = 'missing'
+        header = request.headers.get('Authorization', '')
+        if header.startswith('Bearer '):
+            request.account_id, request.player_id, reason = self.masterserver.signer.verify(header[len('Bearer '):].strip())
+            if request.account_id is not None:
+                return
+
+        self.masterserver.auth_failures.inc(endpoint=endpoint, reason=reason)
+        request.handler = None
+        cherrypy.response.status = 401
+        cherrypy.response.headers['WWW-Authenticate'] = 'Bearer'
+        cherrypy.response.headers['Content-Type'] = 'application/json'
+        cherrypy.response.body = [b'{"error": true, "message": "Not logged in to the master server"}']
+
 class MasterServer(object):
 
+    # Endpoints reported individually in the metrics, anything else is counted as 'other'
+    endpoints = ('register_server', 'update_server', 'unregister_server', 'get_serverlist', 'get_server', 'find_friend_sessions', 'matchmake', 'reserve_slots', 'group_join', 'perform_heartbeat', 'login', 'metrics')
+
     def __init__(self):
         # Time between heartbeat in seconds, this is passed to the client and kept in sync.
         self.time_between_heartbeats = 30
-        self.serverlist = []
-        thread = Thread(target = self.heartbeat)
+        # Registered servers by session id, and the session id registered on each server_key(ip, port).
+        # Anything that changes these indexes or a server's reservations holds servers_lock. Reservations are replaced rather
+        # than changed in place, so lookups and listings read a consistent snapshot without taking the lock.
+        self.servers = {}
+        self.servers_by_address = {}
+        # Session id each listed player is in. A server only takes a player over from another live server that still lists
+        # them if the player holds a slot on it, see index_player
+        self.sessions_by_player = {}
+        # Session ids of the servers running each game mode, the candidates matchmake scores
+        self.servers_by_gamemode = {}
+        # Players each account holds slots for, mapped to the session id of the server holding them. Dead holds are
+        # dropped when the account holds again and swept by the heartbeat thread
+        self.holds_by_account = {}
+        # (player id, session id) of the holds made from each client IP, kept the same way
+        self.holds_by_ip = {}
+        self.servers_lock = Lock()
+
+        self.registry = Registry()
+        self.requests_total = self.registry.counter('masterserver_requests_total', 'Requests handled, by endpoint and HTTP status code.', ('endpoint', 'code'))
+        self.requests_in_flight = self.registry.gauge('masterserver_requests_in_flight', 'Requests currently being handled, by endpoint.', ('endpoint',))
+        self.request_duration = self.registry.histogram('masterserver_request_duration_seconds', 'Time spent handling requests, by endpoint.', ('endpoint',))
+        self.serialization_duration = self.registry.histogram('masterserver_serialization_duration_seconds', 'Time spent serializing JSON responses, by endpoint.', ('endpoint',))
+        self.registered_servers = self.registry.gauge('masterserver_registered_servers', 'Servers currently listed in the server browser.', callback=lambda: len(self.servers))
+        self.expired_servers = self.registry.counter('masterserver_expired_servers_total', 'Servers removed from the list for missing their heartbeat.')
+        self.reachability_probes = self.registry.counter('masterserver_reachability_probes_total', 'Reachability probes made when a new server registers, by outcome.', ('outcome',))
+        self.reachability_probe_duration = self.registry.histogram('masterserver_reachability_probe_duration_seconds', 'Time spent probing newly registered servers.')
+        self.rejected_requests = self.registry.counter('masterserver_rejected_requests_total', 'Requests rejected with a 429 by admission control, by endpoint and reason.', ('endpoint', 'reason'))
+
+        self.auth_failures = self.registry.counter('masterserver_auth_failures_total', 'Requests rejected with a 401 for a missing or invalid login token, by endpoint and reason.', ('endpoint', 'reason'))
+        self.logins = self.registry.counter('masterserver_logins_total', 'Login tokens issued, by whether they continue an existing account.', ('kind',))
+
+        self.admission = AdmissionControl(RATE_LIMITS, RATE_LIMIT_EXEMPT_IPS)
+        self.signer = TokenSigner(AUTH_SECRET, AUTH_TOKEN_LIFETIME)
+
+        # Daemon so the process can exit once the web server stops
+        thread = Thread(target = self.heartbeat, daemon = True)
         thread.start()
 
 
     def heartbeat(self):
+        next_hold_sweep = time.time() + RESERVATION_LIFETIME
         while True:
-            for server in self.serverlist:
+            # Iterate over a copy, requests add and remove servers while we go
+            for server in list(self.servers.values()):
                 delta = int(time.time()) - server.timeoflastheartbeat
-                if (delta > self.time_between_heartbeats):
-                    self.serverlist.remove(server)
+                if (delta > self.time_between_heartbeats and self.remove_server(server)):
+                    self.expired_servers.inc()
+            if time.time() >= next_hold_sweep:
+                self.sweep_holds(time.time())
+                next_hold_sweep = time.time() + RESERVATION_LIFETIME
             sleep(1)
+
+    def server_key(self, ip, port):
+        return '%s:%s' % (ip, port)
+
+    def find_server(self, ip, port, id=None):
+        """Returns the caller's server by session id, or by ip:port for plugins that don't send one. None if the caller has no such server"""
+        id = normalize_id(id)
+        if id is None:
+            id = self.servers_by_address.get(self.server_key(ip, port))
+        server = self.servers.get(id) if id is not None else None
+        if server is None or server.ip != ip or server.owner != cherrypy.request.account_id:
+            return None
+        return server
+
+    def add_server(self, server):
+        """Lists server, replacing the caller's server on the same address. Returns the server listed under its session id, which belongs to another account if it isn't ours"""
+        key = self.server_key(server.ip, server.port)
+        with self.servers_lock:
+            existing = self.servers.get(server.id)
+            if existing is not None:
+                return existing
+            previous = self.servers.get(self.servers_by_address.get(key))
+            if previous is not None:
+                if previous.owner != server.owner:
+                    return previous
+                # The game server moved on to a new session without unregistering the old one
+                del self.servers[previous.id]
+                self.unindex_players(previous)
+                self.set_gamemode_index(previous, None)
+            self.servers[server.id] = server
+            self.servers_by_address[key] = server.id
+            self.servers_by_gamemode.setdefault(server.gamemode, set()).add(server.id)
+            now = time.time()
+            for player in server.players:
+                self.index_player(server, player, now)
+            return server
+
+    def remove_server(self, server):
+        """Removes server if it is still listed, returns whether it was"""
+        with self.servers_lock:
+            if self.servers.get(server.id) is not server:
+                return False
+            del self.servers[server.id]
+            key = self.server_key(server.ip, server.port)
+            if self.servers_by_address.get(key) == server.id:
+                del self.servers_by_address[key]
+            self.unindex_players(server)
+            self.set_gamemode_index(server, None)
+            return True
+
+    def set_gamemode_index(self, server, gamemode):
+        """Moves server to the game mode index entry for gamemode, None to drop it. Called holding servers_lock"""
+        ids = self.servers_by_gamemode.get(server.gamemode)
+        if ids is not None:
+            ids.discard(server.id)
+            if not ids:
+                del self.servers_by_gamemode[server.gamemode]
+        if gamemode is not None:
+            self.servers_by_gamemode.setdefault(gamemode, set()).add(server.id)
+
+    def unindex_players(self, server, keep=frozenset()):
+        """Drops the players of server not in keep from the player index. Called holding servers_lock"""
+        for player in server.players - keep:
+            # The player may have moved on to another server since
+            if self.sessions_by_player.get(player) == server.id:
+                del self.sessions_by_player[player]
+
+    def index_player(self, server, player, now):
+        """Points the player index at server, unless another live server still lists the player and the player holds no slot
+        on server. Any host can list any ids, so this keeps one from pointing friends' lookups away from where a player is.
+        Called holding servers_lock"""
+        current = self.servers.get(self.sessions_by_player.get(player))
+        if current is not None and current is not server and player in current.players:
+            hold = server.reservations.get(player)
+            if hold is None or hold.expires <= now:
+                return
+        self.sessions_by_player[player] = server.id
+
+    def set_server_players(self, server, players):
+        """Replaces the players listed on server with a comma separated list of ids"""
+        players = frozenset(normalize_player_ids(players, MAX_PLAYERS_PER_SERVER))
+        with self.servers_lock:
+            if self.servers.get(server.id) is not server:
+                server.players = players
+                return
+            self.unindex_players(server, players)
+            now = time.time()
+            for player in players:
+                self.index_player(server, player, now)
+            server.players = players
+
+    def endpoint_label(self, path):
+        endpoint = path.strip('/')
+        if endpoint in self.endpoints:
+            return endpoint
+        return 'other'
+
+    def to_json(self, endpoint, payload):
+        start = time.perf_counter()
+        result = json.dumps(payload)
+        self.serialization_duration.observe(time.perf_counter() - start, endpoint=endpoint)
+        return result
+
+    def probe_server(self, ip, port):
+        start = time.perf_counter()
+        outcome = 'reachable'
+        try:
+            requests.get('http://' + ip + ':' + port, timeout=2)
+        except requests.exceptions.ConnectTimeout:
+            outcome = 'timeout'
+        except requests.exceptions.ConnectionError:
+            outcome = 'refused'
+        except requests.exceptions.RequestException:
+            outcome = 'error'
+        self.reachability_probe_duration.observe(time.perf_counter() - start)
+        self.reachability_probes.inc(outcome=outcome)
+        return outcome
             
     @cherrypy.expose
-    def register_server(self, name, port, map, maxplayers, pwprotected, gamemode):
-        if self.server_exists(cherrypy.request.remote.ip, port):
-            self.internal_update_server(cherrypy.request.remote.ip, port, name, map, 0, maxplayers, pwprotected, gamemode)
-            return json.dumps({'error' : False, 'message' : 'Sucessfully updated your server [%s %s:%s] on the server browser.' % (name, cherrypy.request.remote.ip, port)})
+    def login(self, ticket='', token=None, player=''):
+        if AUTHORIZATION_TICKETS and ticket not in AUTHORIZATION_TICKETS:
+            return self.to_json('login', {'error' : True, 'message' : 'Invalid authorization ticket'})
+
+        # Keep the account of a token that was issued by us, even one that has recently expired
+        account_id = None
+        player_id = None
+        if token:
+            account_id, player_id, reason = self.signer.verify(token, grace=AUTH_TOKEN_LIFETIME)
+        # The player the account plays as is the only one it can hold a slot for on its own, see hold_refusal.
+        # It is bound once when the account is made and kept by every refresh
+        player = normalize_id(player)
+        kind = 'refresh'
+        if account_id is None:
+            account_id = new_account_id()
+            player_id = player or ''
+            kind = 'new'
+        elif player is not None and player != player_id:
+            return self.to_json('login', {'error' : True, 'message' : 'Login token is for another player'})
+        self.logins.inc(kind=kind)
+        return self.to_json('login', {'error' : False, 'message' : '', 'id' : account_id, 'token' : self.signer.issue(account_id, player_id), 'expires_in' : AUTH_TOKEN_LIFETIME})
+
+    @cherrypy.expose
+    def register_server(self, name, port, map, maxplayers, pwprotected, gamemode, playercount=0, id=None, players=None, region=''):
+        # Plugins that don't send their session id get one, returned so they can send it back
+        id = normalize_id(id) or uuid4().hex
+        if id in self.servers:
+            server = self.internal_update_server(cherrypy.request.remote.ip, port, id, name, map, playercount, maxplayers, pwprotected, gamemode, players, region)
+            if server is None:
+                return self.to_json('register_server', {'error' : True, 'message' : 'Server [%s %s:%s] is registered by another account.' % (name, cherrypy.request.remote.ip, port)})
+            return self.to_json('register_server', {'error' : False, 'message' : 'Sucessfully updated your server [%s %s:%s] on the server browser.' % (name, cherrypy.request.remote.ip, port), 'heartbeat' : self.time_between_heartbeats, 'id' : server.id })
         else:
             server = Server()
+            server.id = id
+            server.owner = cherrypy.request.account_id
             server.ip = cherrypy.request.remote.ip
             server.name = name
             server.port = port
             server.map = map
+            server.playercount = playercount
             server.maxplayers = maxplayers
             server.pwprotected = pwprotected
             server.gamemode = gamemode
+            server.region = region
             server.timeoflastheartbeat = int(time.time())
-            try:
-                r = requests.get('http://' + cherrypy.request.remote.ip + ':' + port, timeout=2)
-            except requests.exceptions.ConnectTimeout:
+            if players is not None:
+                server.players = frozenset(normalize_player_ids(players, MAX_PLAYERS_PER_SERVER))
+            if self.probe_server(cherrypy.request.remote.ip, port) == 'timeout':
                 # ports are not forwarded...
                 if (cherrypy.request.remote.ip != "127.0.0.1"):
-                    return json.dumps({'error' : True, 'message' : 'Unable to connect to server [%s %s:%s]. Please verify your ports are forwarded and your firewall is not blocking the game. Your server will not be visible in the Server Browser.' % (server.name, server.ip, server.port)})
-            except requests.exceptions.ConnectionError:
-                pass
-
-            self.serverlist.append(server)
-            return json.dumps({'error' : False, 'message' : 'Sucessfully added your server [%s %s:%s] to the server browser.' % (name, cherrypy.request.remote.ip, port), 'heartbeat' : self.time_between_heartbeats })
-
-
-    def internal_update_server(self, ip, port, name, map, playercount, maxplayers, pwprotected, gamemode):
-        for server in self.serverlist:
-            if server.ip == ip and server.port == port: 
-                server.name = name
-                server.map = map
-                server.playercount = playercount
-                server.maxplayers = maxplayers
-                server.pwprotected = pwprotected
-                server.gamemode = gamemode
-                server.timeoflastheartbeat = int(time.time())
-                return True
-        return False
+                    return self.to_json('register_server', {'error' : True, 'message' : 'Unable to connect to server [%s %s:%s]. Please verify your ports are forwarded and your firewall is not blocking the game. Your server will not be visible in the Server Browser.' % (server.name, server.ip, server.port)})
+
+            # Another request may have registered the session or the address while we probed it
+            existing = self.add_server(server)
+            if existing is not server and existing.owner != server.owner:
+                return self.to_json('register_server', {'error' : True, 'message' : 'Server [%s %s:%s] is registered by another account.' % (name, cherrypy.request.remote.ip, port)})
+            return self.to_json('register_server', {'error' : False, 'message' : 'Sucessfully added your server [%s %s:%s] to the server browser.' % (name, cherrypy.request.remote.ip, port), 'heartbeat' : self.time_between_heartbeats, 'id' : existing.id })
+
+
+    def internal_update_server(self, ip, port, id, name, map, playercount, maxplayers, pwprotected, gamemode, players=None, region=''):
+        server = self.find_server(ip, port, id)
+        if server is not None:
+            # Plugins list their players with every update, leaving them out keeps the last list
+            if players is not None:
+                self.set_server_players(server, players)
+            if gamemode != server.gamemode:
+                with self.servers_lock:
+                    if self.servers.get(server.id) is server:
+                        self.set_gamemode_index(server, gamemode)
+            server.name = name
+            server.map = map
+            server.playercount = playercount
+            server.maxplayers = maxplayers
+            server.pwprotected = pwprotected
+            server.gamemode = gamemode
+            server.region = region
+            server.timeoflastheartbeat = int(time.time())
+        return server
 
     @cherrypy.expose
-    def update_server(self, port, name, map, playercount, maxplayers, pwprotected, gamemode):
-        if self.internal_update_server(cherrypy.request.remote.ip, port, name, map, playercount, maxplayers, pwprotected, gamemode):
-            return json.dumps({'error' : False, 'message' : 'Sucessfully updated your server [%s %s:%s] on the server browser.' % (name, cherrypy.request.remote.ip, port)})
-        return json.dumps({'error' : True, 'message' : 'Server not registered'})
+    def update_server(self, port, name, map, playercount, maxplayers, pwprotected, gamemode, id=None, players=None, region=''):
+        if self.internal_update_server(cherrypy.request.remote.ip, port, id, name, map, playercount, maxplayers, pwprotected, gamemode, players, region) is not None:
+            return self.to_json('update_server', {'error' : False, 'message' : 'Sucessfully updated your server [%s %s:%s] on the server browser.' % (name, cherrypy.request.remote.ip, port)})
+        return self.to_json('update_server', {'error' : True, 'message' : 'Server not registered'})
          
 
-    def server_exists(self, ip, port):
-        for server in self.serverlist:
-            if server.ip == ip and server.port == port:
-                return True
-        return False
-
     @cherrypy.expose
-    def unregister_server(self, port):
-        for server in self.serverlist:
-            if (server.registeredby == cherrypy.request.remote.ip and server.port == port):
-                self.serverlist.remove(server)
+    def unregister_server(self, port, id=None):
+        # Without an id any server of ours on the address goes, with one only that session
+        server = self.find_server(cherrypy.request.remote.ip, port, id)
+        if server is None:
+            return self.to_json('unregister_server', {'error' : True, 'message' : 'Server not registered'})
+        self.remove_server(server)
+        return self.to_json('unregister_server', {'error' : False, 'message' : 'Sucessfully removed your server [%s %s:%s] from the server browser.' % (server.name, server.ip, port)})
+
+    def server_json(self, server, now):
+        """Returns what clients are told about server, with the slots still held for players taken off its open slots"""
+        return {'openslots' : self.open_slots(server, now), 'name' : server.name, 'port' : server.port, 'map' : server.map, 'playercount' : server.playercount, 'maxplayers' : server.maxplayers, 'pwprotected' : server.pwprotected, 'gamemode' : server.gamemode, 'ip' : server.ip, 'id' : server.id, 'region' : server.region }
+
+    def live_reservations(self, server, now):
+        """Returns the holds on server that haven't expired and whose player hasn't joined yet"""
+        players = server.players
+        return dict((player, hold) for player, hold in server.reservations.items() if hold.expires > now and player not in players)
+
+    def account_holds(self, account, now):
+        """Returns the live holds account asked for as {player id: session id}. Called holding servers_lock"""
+        holds = {}
+        for player, id in self.holds_by_account.get(account, {}).items():
+            server = self.servers.get(id)
+            hold = server.reservations.get(player) if server is not None else None
+            # Someone else may have held a slot for the same player since
+            if hold is not None and hold.account == account and hold.expires > now and player not in server.players:
+                holds[player] = id
+        return holds
+
+    def ip_holds(self, ip, now):
+        """Returns the live holds made from ip as a set of (player id, session id). Called holding servers_lock"""
+        holds = set()
+        for player, id in self.holds_by_ip.get(ip, ()):
+            server = self.servers.get(id)
+            hold = server.reservations.get(player) if server is not None else None
+            if hold is not None and hold.ip == ip and hold.expires > now and player not in server.players:
+                holds.add((player, id))
+        return holds
+
+    def hold_refusal(self, players, now, party=True):
+        """Returns why the caller can't hold slots for players, None if it can. Without party the logged in player is the only
+        one it can hold a slot for. Called holding servers_lock"""
+        player_id = cherrypy.request.player_id
+        if not player_id or player_id not in players:
+            return 'Slots can only be held along with the logged in player'
+        if not party and len(players) > 1:
+            return 'Slots can only be held for the logged in player'
+        holds = self.account_holds(cherrypy.request.account_id, now)
+        if len(set(holds).union(players)) > MAX_HOLDS_PER_ACCOUNT:
+            return 'At most %d slots can be held at once' % MAX_HOLDS_PER_ACCOUNT
+        ip = cherrypy.request.remote.ip
+        # Holds the account moves or extends don't add to the count
+        if ip not in RATE_LIMIT_EXEMPT_IPS and len(self.ip_holds(ip, now)) - len(set(holds).intersection(players)) + len(players) > MAX_HOLDS_PER_IP:
+            return 'Too many slots are held from this address'
+        return None
+
+    def hold_slots(self, server, players, now):
+        """Holds a slot on server for each player until RESERVATION_LIFETIME from now for the caller's account, dropping dead holds
+        and moving the players' holds the account made on other servers. Players another account holds a live slot for on
+        server keep that hold. Called holding servers_lock"""
+        account = cherrypy.request.account_id
+        ip = cherrypy.request.remote.ip
+        holds = self.account_holds(account, now)
+        ip_holds = self.ip_holds(ip, now)
+        reservations = self.live_reservations(server, now)
+        for player in players:
+            # Never take over a live hold another account made, the slot is held for the player either way
+            hold = reservations.get(player)
+            if hold is not None and hold.account != account:
+                continue
+            previous = self.servers.get(holds.get(player))
+            if previous is not None and previous is not server:
+                previous.reservations = dict((other, hold) for other, hold in previous.reservations.items() if other != player)
+            reservations[player] = Hold(now + RESERVATION_LIFETIME, account, ip)
+            holds[player] = server.id
+            ip_holds.add((player, server.id))
+        server.reservations = reservations
+        self.holds_by_account[account] = holds
+        self.holds_by_ip[ip] = ip_holds
+
+    def sweep_holds(self, now):
+        """Forgets the accounts and client IPs whose holds have all ended"""
+        with self.servers_lock:
+            for account in list(self.holds_by_account):
+                holds = self.account_holds(account, now)
+                if holds:
+                    self.holds_by_account[account] = holds
+                else:
+                    del self.holds_by_account[account]
+            for ip in list(self.holds_by_ip):
+                holds = self.ip_holds(ip, now)
+                if holds:
+                    self.holds_by_ip[ip] = holds
+                else:
+                    del self.holds_by_ip[ip]
+
+    def open_slots(self, server, now):
+        """Returns the slots on server no one holds. Only reads server, so it is safe without servers_lock"""
+        try:
+            free = int(server.maxplayers) - int(server.playercount)
+        except (TypeError, ValueError):
+            return 0
+        players = server.players
+        held = sum(1 for player, hold in server.reservations.items() if hold.expires > now and player not in players)
+        return max(0, free - held)
+
+    def slots_needed(self, server, players, now):
+        """Returns how many of players need a new slot on server, ones already holding one or already on it don't"""
+        held = self.live_reservations(server, now)
+        return len([player for player in players if player not in held and player not in server.players])
+
+    def pick_server(self, players, gamemode, map, region, now):
+        """Returns the best server that isn't password protected with room for all the players, None if there is none. Called holding servers_lock"""
+        best = None
+        best_score = None
+        candidates = self.servers_by_gamemode.get(gamemode, ()) if gamemode else self.servers.keys()
+        for id in candidates:
+            server = self.servers[id]
+            if str(server.pwprotected).lower() == 'true':
+                continue
+            open_slots = self.open_slots(server, now)
+            if open_slots < self.slots_needed(server, players, now):
+                continue
+            score = self.matchmaking_score(server, open_slots, map, region)
+            if score is None:
+                continue
+            if best is None or score > best_score:
+                best = server
+                best_score = score
+        return best
+
+    def matchmaking_score(self, server, open_slots, map, region):
+        """Scores a server with room for a match, higher is better. None for a server whose maxplayers isn't a number"""
+        try:
+            maxplayers = max(1, int(server.maxplayers))
+        except (TypeError, ValueError):
+            return None
+        # Fuller servers first, so players end up together rather than spread thin
+        score = MATCHMAKING_FILL_WEIGHT * (maxplayers - open_slots) / maxplayers
+        if region and server.region == region:
+            score += MATCHMAKING_REGION_WEIGHT
+        if map and server.map == map:
+            score += MATCHMAKING_MAP_WEIGHT
+        return score
 
     @cherrypy.expose
     def get_serverlist(self):
-        self.returnlist = []
-        for server in self.serverlist:
-            jsonstring = {'name' : server.name, 'port' : server.port, 'map' : server.map, 'playercount' : server.playercount, 'maxplayers' : server.maxplayers, 'pwprotected' : server.pwprotected, 'gamemode' : server.gamemode, 'ip' : server.ip }
-            self.returnlist.append(jsonstring)
-        return json.dumps({'error' : False, 'message' : '', 'servers' : self.returnlist})
+        now = time.time()
+        returnlist = [self.server_json(server, now) for server in list(self.servers.values())]
+        return self.to_json('get_serverlist', {'error' : False, 'message' : '', 'servers' : returnlist})
+
+    @cherrypy.expose
+    def get_server(self, id=''):
+        # A single server by session id, for following an invite or rejoining without fetching the whole list
+        id = normalize_id(id)
+        server = self.servers.get(id) if id is not None else None
+        if server is None:
+            return self.to_json('get_server', {'error' : True, 'message' : 'Server not found'})
+        return self.to_json('get_server', {'error' : False, 'message' : '', 'server' : self.server_json(server, time.time())})
+
+    @cherrypy.expose
+    def find_friend_sessions(self, players=''):
+        # Resolves a whole friends list in one request. Each server is listed once, with the friends found on it
+        servers = {}
+        now = time.time()
+        for player in normalize_player_ids(players, MAX_FRIENDS_PER_LOOKUP):
+            server = self.servers.get(self.sessions_by_player.get(player))
+            if server is None:
+                continue
+            entry = servers.get(server.id)
+            if entry is None:
+                entry = servers[server.id] = self.server_json(server, now)
+                entry['friends'] = []
+            entry['friends'].append(player)
+        return self.to_json('find_friend_sessions', {'error' : False, 'message' : '', 'servers' : list(servers.values())})
+
+    @cherrypy.expose
+    def matchmake(self, players='', gamemode='', map='', region=''):
+        # Picks the best server with room for all the players and holds their slots, so joining a match costs one request
+        # rather than a list download, and players matched at the same time aren't all sent to the same last slot
+        players = normalize_player_ids(players, MAX_MATCHMAKING_PLAYERS)
+        if not players:
+            return self.to_json('matchmake', {'error' : True, 'message' : 'No players to matchmake'})
+
+        now = time.time()
+        with self.servers_lock:
+            # The logged in player's own local players come along, all counted against the account's holds
+            refusal = self.hold_refusal(players, now)
+            if refusal is not None:
+                return self.to_json('matchmake', {'error' : True, 'message' : refusal})
+            best = self.pick_server(players, gamemode, map, region, now)
+            if best is None:
+                return self.to_json('matchmake', {'error' : True, 'message' : 'No server has room for %d players' % len(players)})
+            self.hold_slots(best, players, now)
+            result = self.server_json(best, now)
+        return self.to_json('matchmake', {'error' : False, 'message' : '', 'server' : result, 'reservation_expires_in' : RESERVATION_LIFETIME})
+
+    @cherrypy.expose
+    def reserve_slots(self, id='', players=''):
+        # Holds a slot for the logged in player on a server picked from the list before joining it, so clients that fetched the
+        # same list don't all connect to its last slot. A full server is a normal answer rather than an error, the client gives up on the join
+        players = normalize_player_ids(players, MAX_MATCHMAKING_PLAYERS)
+        if not players:
+            return self.to_json('reserve_slots', {'error' : True, 'message' : 'No players to reserve slots for'})
+
+        id = normalize_id(id)
+        now = time.time()
+        with self.servers_lock:
+            refusal = self.hold_refusal(players, now, party=False)
+            if refusal is not None:
+                return self.to_json('reserve_slots', {'error' : True, 'message' : refusal})
+            server = self.servers.get(id) if id is not None else None
+            if server is None:
+                return self.to_json('reserve_slots', {'error' : True, 'message' : 'Server not found'})
+            # Players already holding a slot keep it and only have it extended
+            if self.open_slots(server, now) < self.slots_needed(server, players, now):
+                return self.to_json('reserve_slots', {'error' : False, 'message' : 'Server is full', 'reserved' : False})
+            self.hold_slots(server, players, now)
+        return self.to_json('reserve_slots', {'error' : False, 'message' : '', 'reserved' : True, 'reservation_expires_in' : RESERVATION_LIFETIME})
+
+    @cherrypy.expose
+    def group_join(self, players='', id='', gamemode='', map='', region=''):
+        # Finds a server with room for a whole party and holds the leader's slot. The other members hold their own slots with
+        # reserve_slots as they join, so only players who logged in themselves get one. With an id the party goes to that
+        # server, otherwise one is picked as matchmake would
+        players = normalize_player_ids(players, MAX_MATCHMAKING_PLAYERS)
+        if not players:
+            return self.to_json('group_join', {'error' : True, 'message' : 'No players in the group'})
+
+        leader = cherrypy.request.player_id
+        if not leader or leader not in players:
+            return self.to_json('group_join', {'error' : True, 'message' : 'The group must include the logged in player'})
+        now = time.time()
+        with self.servers_lock:
+            refusal = self.hold_refusal([leader], now, party=False)
+            if refusal is not None:
+                return self.to_json('group_join', {'error' : True, 'message' : refusal})
+            if id:
+                id = normalize_id(id)
+                server = self.servers.get(id) if id is not None else None
+                if server is None:
+                    return self.to_json('group_join', {'error' : True, 'message' : 'Server not found'})
+                if self.open_slots(server, now) < self.slots_needed(server, players, now):
+                    server = None
+            else:
+                server = self.pick_server(players, gamemode, map, region, now)
+            if server is None:
+                return self.to_json('group_join', {'error' : True, 'message' : 'No server has room for %d players' % len(players)})
+            self.hold_slots(server, [leader], now)
+            result = self.server_json(server, now)
+        return self.to_json('group_join', {'error' : False, 'message' : '', 'server' : result, 'players' : players, 'reservation_expires_in' : RESERVATION_LIFETIME})
+
+    @cherrypy.expose
+    def perform_heartbeat(self, port, playercount=None, id=None, players=None):
+        server = self.find_server(cherrypy.request.remote.ip, port, id)
+        if server is None:
+            # Expired or never registered, the plugin registers the session again
+            return self.to_json('perform_heartbeat', {'error' : True, 'message' : 'Server not registered'})
+        server.timeoflastheartbeat = int(time.time())
+        # Servers send their player count and players along with the heartbeat when they have changed
+        if playercount is not None:
+            server.playercount = playercount
+        if players is not None:
+            self.set_server_players(server, players)
+        return self.to_json('perform_heartbeat', {'error' : False, 'message' : ''})
 
     @cherrypy.expose
-    def perform_heartbeat(self, port):
-        for server in self.serverlist:
-            if (server.ip == cherrypy.request.remote.ip and server.port == port):
-                server.timeoflastheartbeat = int(time.time())
+    def metrics(self):
+        cherrypy.response.headers['Content-Type'] = CONTENT_TYPE
+        return self.registry.render()
 
 
 
 
 
-cherrypy.config.update({ 'server.socket_port': 8081,
-                         'server.socket_host': '0.0.0.0',
-                         "server.ssl_module": "pyopenssl",
-                         'server.thread_pool' : 100
-                       })
+# Importing the module, as the tests do, doesn't start the server
+if __name__ == '__main__':
+    cherrypy.config.update({ 'server.socket_port': 8081,
+                             'server.socket_host': '0.0.0.0',
+                             "server.ssl_module": "pyopenssl",
+                             'server.thread_pool' : 100
+                           })
 
-masterserver = MasterServer()
-cherrypy.quickstart(masterserver)
+    masterserver = MasterServer()
+    cherrypy.tools.request_metrics = RequestMetricsTool(masterserver)
+    cherrypy.tools.admission_control = AdmissionControlTool(masterserver)
+    cherrypy.tools.auth = AuthTool(masterserver)
+    cherrypy.quickstart(masterserver, '/', {'/' : {'tools.request_metrics.on' : True, 'tools.admission_control.on' : True, 'tools.auth.on' : True}})
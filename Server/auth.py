@@ -0,0 +1,62 @@
+
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Stateless session tokens for the master server. A token carries the account it was issued to, the player the account
+# logged in as and when it expires, signed with HMAC-SHA256, so checking one needs the secret but no lookup.
+#
+# Token format: <account id>.<player id, may be empty>.<expiry unix time>.<base64url signature of the first three fields>
+
+import base64
+import hashlib
+import hmac
+import time
+import uuid
+
+
+def new_account_id():
+    # 32 hex digits, the form the plugin reads ids back from exactly
+    return uuid.uuid4().hex
+
+
+class TokenSigner(object):
+
+    def __init__(self, secret, lifetime):
+        # Key the tokens are signed with, tokens signed with a different key are rejected
+        self.secret = secret
+        # Seconds a token is valid for after it is issued
+        self.lifetime = int(lifetime)
+
+    def sign(self, payload):
+        digest = hmac.new(self.secret, payload.encode('utf-8'), hashlib.sha256).digest()
+        return base64.urlsafe_b64encode(digest).rstrip(b'=').decode('ascii')
+
+    def issue(self, account_id, player_id='', now=None):
+        # Returns a token for the account playing as player_id, valid for lifetime seconds
+        if now is None:
+            now = time.time()
+        payload = '%s.%s.%d' % (account_id, player_id, int(now) + self.lifetime)
+        return payload + '.' + self.sign(payload)
+
+    def verify(self, token, now=None, grace=0):
+        # Returns (account id, player id, None) for a valid token, otherwise (None, None, reason) with reason one of
+        # 'malformed', 'bad_signature' or 'expired'. A token up to grace seconds past its expiry still passes.
+        if now is None:
+            now = time.time()
+        parts = token.split('.')
+        if len(parts) != 4:
+            return None, None, 'malformed'
+        account_id, player_id, expires, signature = parts
+        if not hmac.compare_digest(self.sign('.'.join((account_id, player_id, expires))), signature):
+            return None, None, 'bad_signature'
+        try:
+            expires = int(expires)
+        except ValueError:
+            return None, None, 'malformed'
+        if now > expires + grace:
+            return None, None, 'expired'
+        return account_id, player_id, None
@@ -0,0 +1,204 @@
+
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Load generator for OnlineSubsystemPythonServer.py
+#
+# Simulates N game servers (login, register, heartbeat, player count updates, unregister or expire)
+# and M browsing clients (get_serverlist at a fixed rate) against a master server, then
+# reports throughput and p50/p99/p999 latency per endpoint.
+#
+# $ python3 loadtest.py --host 127.0.0.1:8081 --servers 200 --clients 50 --duration 60
+
+import argparse
+import json
+import math
+import random
+import threading
+import time
+import uuid
+import requests
+
+# Seconds before a heartbeat within which a player count change waits to be sent with it, as the plugin does
+PLAYERCOUNT_HEARTBEAT_WAIT = 5.0
+
+
+class EndpointStats(object):
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.errors = {}
+
+    def record(self, endpoint, seconds, ok):
+        with self.lock:
+            self.latencies.setdefault(endpoint, []).append(seconds)
+            if not ok:
+                self.errors[endpoint] = self.errors.get(endpoint, 0) + 1
+
+    def report(self, elapsed):
+        print('%-20s %8s %8s %10s %10s %10s %10s' % ('endpoint', 'requests', 'errors', 'req/s', 'p50 ms', 'p99 ms', 'p999 ms'))
+        with self.lock:
+            for endpoint in sorted(self.latencies):
+                samples = sorted(self.latencies[endpoint])
+                print('%-20s %8d %8d %10.1f %10.2f %10.2f %10.2f' % (
+                    endpoint,
+                    len(samples),
+                    self.errors.get(endpoint, 0),
+                    len(samples) / elapsed,
+                    percentile(samples, 0.50) * 1000.0,
+                    percentile(samples, 0.99) * 1000.0,
+                    percentile(samples, 0.999) * 1000.0))
+
+
+def percentile(sorted_samples, fraction):
+    if not sorted_samples:
+        return 0.0
+    # Nearest-rank percentile
+    index = min(len(sorted_samples), max(1, int(math.ceil(fraction * len(sorted_samples))))) - 1
+    return sorted_samples[index]
+
+
+class LoadGenerator(object):
+
+    def __init__(self, args):
+        self.args = args
+        self.base_url = 'http://' + args.host
+        self.stats = EndpointStats()
+        self.stop_event = threading.Event()
+
+    def call(self, session, endpoint, params):
+        start = time.perf_counter()
+        ok = False
+        body = None
+        try:
+            response = session.get(self.base_url + '/' + endpoint, params=params, timeout=self.args.timeout)
+            ok = response.status_code == 200
+            body = response.text
+        except requests.exceptions.RequestException:
+            pass
+        self.stats.record(endpoint, time.perf_counter() - start, ok)
+        return body
+
+    def wait(self, seconds):
+        # Returns True when the run is over
+        return self.stop_event.wait(seconds)
+
+    def simulate_server(self, index):
+        session = requests.Session()
+        port = self.args.base_port + index
+        name = 'LoadTest Server %d' % index
+        maxplayers = self.args.max_players
+        # Like the plugin, each server generates its session id and sends it with every request
+        session_id = uuid.uuid4().hex
+        params = {'id': session_id, 'name': name, 'port': port, 'map': 'LoadTestMap', 'maxplayers': maxplayers, 'pwprotected': 'false', 'gamemode': 'LoadTest'}
+
+        # Changes to the server list need a login token, like the plugin each server logs in first
+        try:
+            token = json.loads(self.call(session, 'login', {'ticket': self.args.ticket}))['token']
+            session.headers['Authorization'] = 'Bearer ' + token
+        except (TypeError, ValueError, KeyError):
+            pass
+
+        heartbeat = self.args.heartbeat
+        body = self.call(session, 'register_server', params)
+        if heartbeat <= 0:
+            heartbeat = 30
+            try:
+                heartbeat = max(1.0, float(json.loads(body)['heartbeat']) - 1.0)
+            except (TypeError, ValueError, KeyError):
+                pass
+
+        # A fraction of the servers simply stop heartbeating half way through so the master server has to expire them
+        expires = random.random() < self.args.expire_fraction
+        expire_at = time.time() + self.args.duration * 0.5
+
+        playercount = None
+        next_heartbeat = time.time() + heartbeat
+        next_update = time.time() + random.uniform(0, self.args.update_interval)
+        while not self.stop_event.is_set():
+            now = time.time()
+            if expires and now >= expire_at:
+                return
+            if now >= next_update:
+                # Like the plugin, leave the new player count to a heartbeat that is nearly due
+                playercount = random.randint(0, maxplayers)
+                if next_heartbeat - now > PLAYERCOUNT_HEARTBEAT_WAIT:
+                    update = dict(params)
+                    update['playercount'] = playercount
+                    self.call(session, 'update_server', update)
+                    playercount = None
+                next_update = now + self.args.update_interval
+            if now >= next_heartbeat:
+                beat = {'id': session_id, 'port': port}
+                if playercount is not None:
+                    beat['playercount'] = playercount
+                    playercount = None
+                self.call(session, 'perform_heartbeat', beat)
+                next_heartbeat = now + heartbeat
+            if self.wait(max(0.01, min(next_heartbeat, next_update) - time.time())):
+                break
+
+        self.call(session, 'unregister_server', {'id': session_id, 'port': port})
+
+    def simulate_client(self, index):
+        session = requests.Session()
+        interval = 1.0 / self.args.list_rate
+        # Spread the clients out so they don't all poll in lockstep
+        if self.wait(random.uniform(0, interval)):
+            return
+        while not self.stop_event.is_set():
+            start = time.time()
+            self.call(session, 'get_serverlist', {})
+            if self.wait(max(0.0, interval - (time.time() - start))):
+                break
+
+    def run(self):
+        threads = []
+        for index in range(self.args.servers):
+            threads.append(threading.Thread(target=self.simulate_server, args=(index,)))
+        for index in range(self.args.clients):
+            threads.append(threading.Thread(target=self.simulate_client, args=(index,)))
+
+        start = time.time()
+        for thread in threads:
+            thread.daemon = True
+            thread.start()
+            # Ramp up gradually rather than registering every server in the same instant
+            sleep_for = self.args.ramp_up / max(1, len(threads))
+            if sleep_for > 0:
+                time.sleep(sleep_for)
+
+        time.sleep(max(0.0, self.args.duration - (time.time() - start)))
+        self.stop_event.set()
+        for thread in threads:
+            thread.join(self.args.timeout * 2)
+
+        elapsed = time.time() - start
+        print('Simulated %d servers and %d clients for %.1f seconds against %s' % (self.args.servers, self.args.clients, elapsed, self.args.host))
+        self.stats.report(elapsed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Load generator for the Online Subsystem Python master server.')
+    parser.add_argument('--host', default='127.0.0.1:8081', help='master server address (ip:port)')
+    parser.add_argument('--servers', type=int, default=100, help='number of simulated game servers')
+    parser.add_argument('--clients', type=int, default=20, help='number of simulated browsing clients')
+    parser.add_argument('--duration', type=float, default=60.0, help='length of the run in seconds')
+    parser.add_argument('--ramp-up', type=float, default=5.0, help='seconds over which the simulated servers and clients are started')
+    parser.add_argument('--heartbeat', type=float, default=0.0, help='seconds between heartbeats, defaults to the interval returned by register_server')
+    parser.add_argument('--update-interval', type=float, default=10.0, help='seconds between player count updates per server')
+    parser.add_argument('--list-rate', type=float, default=1.0, help='get_serverlist requests per second per client')
+    parser.add_argument('--expire-fraction', type=float, default=0.1, help='fraction of servers that stop heartbeating instead of unregistering')
+    parser.add_argument('--max-players', type=int, default=16, help='max players advertised by each simulated server')
+    parser.add_argument('--base-port', type=int, default=20000, help='first game port used by the simulated servers')
+    parser.add_argument('--timeout', type=float, default=10.0, help='request timeout in seconds')
+    parser.add_argument('--ticket', default='', help='authorization ticket the simulated servers log in with')
+    LoadGenerator(parser.parse_args()).run()
+
+
+if __name__ == '__main__':
+    main()
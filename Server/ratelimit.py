@@ -0,0 +1,111 @@
+
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Admission control for the master server: per IP token buckets and per endpoint concurrency limits
+
+import math
+import threading
+import time
+
+# Seconds a bucket may sit unused before it is forgotten
+IDLE_BUCKET_SECONDS = 300
+
+
+class EndpointLimit(object):
+    def __init__(self, rate, burst, max_concurrent):
+        # Requests per second each IP may sustain
+        self.rate = float(rate)
+        # Requests each IP may make back to back before being limited
+        self.burst = float(burst)
+        # Requests to this endpoint handled at once across all clients, 0 for no limit
+        self.max_concurrent = max_concurrent
+
+
+class TokenBucket(object):
+    def __init__(self, rate, burst, now):
+        self.rate = rate
+        self.burst = burst
+        self.tokens = burst
+        self.updated = now
+
+    def take(self, now):
+        # Returns 0 if a token was taken, otherwise the seconds until one is available
+        self.tokens = min(self.burst, self.tokens + (now - self.updated) * self.rate)
+        self.updated = now
+        if self.tokens >= 1.0:
+            self.tokens -= 1.0
+            return 0.0
+        if self.rate <= 0.0:
+            return float('inf')
+        return (1.0 - self.tokens) / self.rate
+
+
+class AdmissionControl(object):
+
+    def __init__(self, limits, exempt_ips=()):
+        # endpoint -> EndpointLimit, endpoints without an entry are never limited
+        self.limits = limits
+        self.exempt_ips = frozenset(exempt_ips)
+        # (ip, endpoint) -> TokenBucket
+        self.buckets = {}
+        # endpoint -> requests currently being handled
+        self.in_flight = dict((endpoint, 0) for endpoint in limits)
+        self.lock = threading.Lock()
+        self.next_prune = time.monotonic() + IDLE_BUCKET_SECONDS
+
+    def admit(self, ip, endpoint, now=None):
+        # Returns (None, 0) when the request may go ahead, otherwise the reason it was
+        # rejected ('rate_limited' or 'overloaded') and the seconds the client should wait.
+        # An admitted request must be released once it has been handled.
+        limit = self.limits.get(endpoint)
+        if limit is None:
+            return None, 0
+
+        if now is None:
+            now = time.monotonic()
+        with self.lock:
+            if now >= self.next_prune:
+                self.prune(now)
+
+            # Checked first so a request turned away for load doesn't also cost the client a token
+            if limit.max_concurrent and self.in_flight[endpoint] >= limit.max_concurrent:
+                return 'overloaded', 1
+
+            if ip not in self.exempt_ips:
+                key = (ip, endpoint)
+                bucket = self.buckets.get(key)
+                if bucket is None:
+                    bucket = TokenBucket(limit.rate, limit.burst, now)
+                    self.buckets[key] = bucket
+                wait = bucket.take(now)
+                if wait > 0.0:
+                    return 'rate_limited', retry_after(wait)
+
+            self.in_flight[endpoint] += 1
+        return None, 0
+
+    def release(self, endpoint):
+        if endpoint not in self.limits:
+            return
+        with self.lock:
+            # A release without a matching admit must not free a slot for another request
+            if self.in_flight[endpoint] > 0:
+                self.in_flight[endpoint] -= 1
+
+    def prune(self, now):
+        # Drop buckets that have refilled and not been touched for a while, must hold the lock
+        for key in [key for key, bucket in self.buckets.items() if now - bucket.updated > IDLE_BUCKET_SECONDS]:
+            del self.buckets[key]
+        self.next_prune = now + IDLE_BUCKET_SECONDS
+
+
+def retry_after(seconds):
+    # Retry-After is a whole number of seconds, never tell a client to retry immediately
+    if seconds == float('inf'):
+        return IDLE_BUCKET_SECONDS
+    return max(1, int(math.ceil(seconds)))
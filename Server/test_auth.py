@@ -0,0 +1,82 @@
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Tests for the login tokens in auth.py, the check every endpoint that changes the server list relies on
+#
+# $ python3 -m unittest test_auth
+
+import unittest
+
+from auth import TokenSigner, new_account_id
+
+ACCOUNT = 'a' * 32
+PLAYER = 'b' * 32
+LIFETIME = 100
+ISSUED = 1000
+
+
+class TokenSignerTest(unittest.TestCase):
+
+    def setUp(self):
+        self.signer = TokenSigner(b'secret', LIFETIME)
+        self.token = self.signer.issue(ACCOUNT, PLAYER, now=ISSUED)
+
+    def test_round_trip(self):
+        self.assertEqual(self.signer.verify(self.token, now=ISSUED), (ACCOUNT, PLAYER, None))
+
+    def test_round_trip_without_player(self):
+        token = self.signer.issue(ACCOUNT, now=ISSUED)
+        self.assertEqual(self.signer.verify(token, now=ISSUED), (ACCOUNT, '', None))
+
+    def test_tampered_signature(self):
+        signature = self.token.rsplit('.', 1)[1]
+        tampered = self.token[:-len(signature)] + ('A' if signature[0] != 'A' else 'B') + signature[1:]
+        self.assertEqual(self.signer.verify(tampered, now=ISSUED), (None, None, 'bad_signature'))
+
+    def test_tampered_fields(self):
+        account, player, expires, signature = self.token.split('.')
+        for fields in ((PLAYER, player, expires), (account, ACCOUNT, expires), (account, player, str(int(expires) + 1000))):
+            tampered = '.'.join(fields + (signature,))
+            self.assertEqual(self.signer.verify(tampered, now=ISSUED), (None, None, 'bad_signature'))
+
+    def test_wrong_key(self):
+        other = TokenSigner(b'other secret', LIFETIME)
+        self.assertEqual(other.verify(self.token, now=ISSUED), (None, None, 'bad_signature'))
+
+    def test_wrong_part_count(self):
+        account, player, expires, signature = self.token.split('.')
+        for token in ('', 'token', '.'.join((account, expires, signature)), self.token + '.extra'):
+            self.assertEqual(self.signer.verify(token, now=ISSUED), (None, None, 'malformed'))
+
+    def test_non_numeric_expiry(self):
+        # Correctly signed, so only the expiry check can turn it away
+        payload = '%s.%s.%s' % (ACCOUNT, PLAYER, 'never')
+        token = payload + '.' + self.signer.sign(payload)
+        self.assertEqual(self.signer.verify(token, now=ISSUED), (None, None, 'malformed'))
+
+    def test_expiry(self):
+        expires = ISSUED + LIFETIME
+        self.assertEqual(self.signer.verify(self.token, now=expires)[2], None)
+        self.assertEqual(self.signer.verify(self.token, now=expires + 1), (None, None, 'expired'))
+
+    def test_expiry_with_grace(self):
+        expires = ISSUED + LIFETIME
+        self.assertEqual(self.signer.verify(self.token, now=expires + 50, grace=50), (ACCOUNT, PLAYER, None))
+        self.assertEqual(self.signer.verify(self.token, now=expires + 51, grace=50), (None, None, 'expired'))
+
+
+class NewAccountIdTest(unittest.TestCase):
+
+    def test_hex_guid(self):
+        account = new_account_id()
+        self.assertEqual(len(account), 32)
+        int(account, 16)
+        self.assertNotEqual(account, new_account_id())
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,82 @@
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Tests for the player index find_friend_sessions looks players up in
+#
+# $ python3 -m unittest test_players
+
+import json
+import time
+import unittest
+
+import cherrypy
+
+from OnlineSubsystemPythonServer import MasterServer, Server
+
+
+def player(n):
+    return '%032x' % n
+
+
+class PlayerIndexTest(unittest.TestCase):
+
+    def setUp(self):
+        self.masterserver = MasterServer()
+        cherrypy.request.remote.ip = '127.0.0.1'
+        self.login('host', '')
+        self.first = self.add_server(1, [player(1)])
+        self.second = self.add_server(2)
+
+    def login(self, account, player_id):
+        # What AuthTool takes from a valid token
+        cherrypy.request.account_id = account
+        cherrypy.request.player_id = player_id
+
+    def add_server(self, n, players=()):
+        server = Server()
+        server.id = '%032x' % (0x1000 + n)
+        server.ip = '127.0.0.1'
+        server.port = str(7776 + n)
+        server.maxplayers = '64'
+        server.gamemode = 'dm'
+        server.owner = 'host'
+        server.players = frozenset(players)
+        server.timeoflastheartbeat = int(time.time())
+        self.masterserver.add_server(server)
+        return server
+
+    def find(self, n):
+        servers = json.loads(self.masterserver.find_friend_sessions(player(n)))['servers']
+        return [server['id'] for server in servers]
+
+    def test_server_cannot_take_over_a_listed_player(self):
+        self.masterserver.set_server_players(self.second, player(1))
+        self.assertEqual(self.find(1), [self.first.id])
+        # Nor by registering with the player already listed
+        self.add_server(3, [player(1)])
+        self.assertEqual(self.find(1), [self.first.id])
+
+    def test_player_dropped_by_their_server_can_be_listed_elsewhere(self):
+        self.masterserver.set_server_players(self.first, '')
+        self.masterserver.set_server_players(self.second, player(1))
+        self.assertEqual(self.find(1), [self.second.id])
+
+    def test_player_listed_on_a_removed_server_can_be_listed_elsewhere(self):
+        self.masterserver.remove_server(self.first)
+        self.masterserver.set_server_players(self.second, player(1))
+        self.assertEqual(self.find(1), [self.second.id])
+
+    def test_player_holding_a_slot_moves_straight_away(self):
+        # The player reserved a slot on the second server before its host listed them, the first hasn't dropped them yet
+        self.login('alice', player(1))
+        self.assertTrue(json.loads(self.masterserver.reserve_slots(self.second.id, player(1)))['reserved'])
+        self.masterserver.set_server_players(self.second, player(1))
+        self.assertEqual(self.find(1), [self.second.id])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,132 @@
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Tests for the per IP token buckets and per endpoint concurrency limits in ratelimit.py
+#
+# $ python3 -m unittest test_ratelimit
+
+import unittest
+
+from ratelimit import AdmissionControl, EndpointLimit, TokenBucket, IDLE_BUCKET_SECONDS, retry_after
+
+
+class TokenBucketTest(unittest.TestCase):
+
+    def test_burst_then_limited(self):
+        bucket = TokenBucket(rate=1.0, burst=3.0, now=0.0)
+        for _ in range(3):
+            self.assertEqual(bucket.take(0.0), 0.0)
+        self.assertAlmostEqual(bucket.take(0.0), 1.0)
+
+    def test_refills_at_rate(self):
+        bucket = TokenBucket(rate=2.0, burst=2.0, now=0.0)
+        bucket.take(0.0)
+        bucket.take(0.0)
+        # Half a second at 2 per second is one token
+        self.assertEqual(bucket.take(0.5), 0.0)
+        self.assertAlmostEqual(bucket.take(0.5), 0.5)
+
+    def test_refill_stops_at_burst(self):
+        bucket = TokenBucket(rate=1.0, burst=2.0, now=0.0)
+        for _ in range(2):
+            self.assertEqual(bucket.take(1000.0), 0.0)
+        self.assertGreater(bucket.take(1000.0), 0.0)
+
+    def test_zero_rate_never_refills(self):
+        bucket = TokenBucket(rate=0.0, burst=1.0, now=0.0)
+        self.assertEqual(bucket.take(0.0), 0.0)
+        self.assertEqual(bucket.take(100.0), float('inf'))
+
+
+class RetryAfterTest(unittest.TestCase):
+
+    def test_rounds_up_to_whole_seconds(self):
+        self.assertEqual(retry_after(0.01), 1)
+        self.assertEqual(retry_after(1.0), 1)
+        self.assertEqual(retry_after(1.2), 2)
+
+    def test_never_refilling_bucket(self):
+        self.assertEqual(retry_after(float('inf')), IDLE_BUCKET_SECONDS)
+
+
+class AdmissionControlTest(unittest.TestCase):
+
+    def setUp(self):
+        self.admission = AdmissionControl({
+            'limited' : EndpointLimit(rate=0.5, burst=2, max_concurrent=0),
+            'busy' : EndpointLimit(rate=100, burst=100, max_concurrent=2),
+        }, exempt_ips=('10.0.0.1',))
+
+    def test_unlisted_endpoint_is_never_limited(self):
+        for _ in range(100):
+            self.assertEqual(self.admission.admit('1.2.3.4', 'other', now=0.0), (None, 0))
+        self.admission.release('other')
+
+    def test_rate_limited_with_retry_after(self):
+        for _ in range(2):
+            self.assertEqual(self.admission.admit('1.2.3.4', 'limited', now=0.0), (None, 0))
+        # A token comes back every 2 seconds
+        self.assertEqual(self.admission.admit('1.2.3.4', 'limited', now=0.0), ('rate_limited', 2))
+        self.assertEqual(self.admission.admit('1.2.3.4', 'limited', now=1.5), ('rate_limited', 1))
+        self.assertEqual(self.admission.admit('1.2.3.4', 'limited', now=2.0), (None, 0))
+
+    def test_buckets_are_per_ip(self):
+        for _ in range(2):
+            self.admission.admit('1.2.3.4', 'limited', now=0.0)
+        self.assertEqual(self.admission.admit('5.6.7.8', 'limited', now=0.0), (None, 0))
+
+    def test_exempt_ip_is_not_rate_limited(self):
+        for _ in range(10):
+            self.assertEqual(self.admission.admit('10.0.0.1', 'limited', now=0.0), (None, 0))
+        self.assertNotIn(('10.0.0.1', 'limited'), self.admission.buckets)
+
+    def test_exempt_ip_still_counts_toward_concurrency(self):
+        for _ in range(2):
+            self.assertEqual(self.admission.admit('10.0.0.1', 'busy', now=0.0), (None, 0))
+        self.assertEqual(self.admission.admit('10.0.0.1', 'busy', now=0.0), ('overloaded', 1))
+
+    def test_release_frees_a_concurrency_slot(self):
+        for _ in range(2):
+            self.admission.admit('1.2.3.4', 'busy', now=0.0)
+        self.assertEqual(self.admission.admit('1.2.3.4', 'busy', now=0.0), ('overloaded', 1))
+        self.admission.release('busy')
+        self.assertEqual(self.admission.in_flight['busy'], 1)
+        self.assertEqual(self.admission.admit('1.2.3.4', 'busy', now=0.0), (None, 0))
+
+    def test_overloaded_costs_no_token(self):
+        limits = {'both' : EndpointLimit(rate=0.001, burst=1, max_concurrent=1)}
+        admission = AdmissionControl(limits)
+        self.assertEqual(admission.admit('5.6.7.8', 'both', now=0.0), (None, 0))
+        self.assertEqual(admission.admit('1.2.3.4', 'both', now=0.0), ('overloaded', 1))
+        admission.release('both')
+        self.assertEqual(admission.admit('1.2.3.4', 'both', now=0.0), (None, 0))
+
+    def test_in_flight_never_goes_negative(self):
+        self.admission.admit('1.2.3.4', 'busy', now=0.0)
+        for _ in range(3):
+            self.admission.release('busy')
+        self.assertEqual(self.admission.in_flight['busy'], 0)
+        # Extra releases don't let more than max_concurrent requests in
+        for _ in range(2):
+            self.assertEqual(self.admission.admit('1.2.3.4', 'busy', now=0.0), (None, 0))
+        self.assertEqual(self.admission.admit('1.2.3.4', 'busy', now=0.0), ('overloaded', 1))
+
+    def test_idle_buckets_are_pruned(self):
+        self.admission.admit('1.2.3.4', 'limited', now=0.0)
+        self.admission.next_prune = 0.0
+        self.admission.admit('5.6.7.8', 'limited', now=IDLE_BUCKET_SECONDS + 1.0)
+        self.assertEqual(list(self.admission.buckets), [('5.6.7.8', 'limited')])
+        self.assertEqual(self.admission.next_prune, 2 * IDLE_BUCKET_SECONDS + 1.0)
+
+    def test_recent_buckets_are_kept(self):
+        self.admission.admit('1.2.3.4', 'limited', now=10.0)
+        self.admission.prune(IDLE_BUCKET_SECONDS)
+        self.assertIn(('1.2.3.4', 'limited'), self.admission.buckets)
+
+
+if __name__ == '__main__':
+    unittest.main()
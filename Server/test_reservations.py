@@ -0,0 +1,154 @@
+# Copyright (c) 2019 Ryan Post
+# This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+# Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+# 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Tests for the slot holds matchmake, reserve_slots and group_join make
+#
+# $ python3 -m unittest test_reservations
+
+import json
+import time
+import unittest
+
+import cherrypy
+
+from OnlineSubsystemPythonServer import MasterServer, Server, MAX_HOLDS_PER_ACCOUNT, MAX_HOLDS_PER_IP
+
+
+def player(n):
+    return '%032x' % n
+
+
+class ReservationTest(unittest.TestCase):
+
+    def setUp(self):
+        self.masterserver = MasterServer()
+        cherrypy.request.remote.ip = '127.0.0.1'
+        self.login('host', '')
+        self.first = self.add_server(1)
+        self.second = self.add_server(2)
+
+    def login(self, account, player_id):
+        # What AuthTool takes from a valid token
+        cherrypy.request.account_id = account
+        cherrypy.request.player_id = player_id
+
+    def add_server(self, n):
+        server = Server()
+        server.id = '%032x' % (0x1000 + n)
+        server.ip = '127.0.0.1'
+        server.port = str(7776 + n)
+        server.maxplayers = '64'
+        server.gamemode = 'dm'
+        server.owner = 'host'
+        server.timeoflastheartbeat = int(time.time())
+        self.masterserver.add_server(server)
+        return server
+
+    def reserve(self, server, players):
+        return json.loads(self.masterserver.reserve_slots(server.id, ','.join(players)))
+
+    def matchmake(self, players):
+        return json.loads(self.masterserver.matchmake(','.join(players), 'dm'))
+
+    def group_join(self, players, server=None):
+        return json.loads(self.masterserver.group_join(','.join(players), server.id if server is not None else '', 'dm'))
+
+    def test_reserve_only_for_own_player(self):
+        self.login('alice', player(1))
+        self.assertTrue(self.reserve(self.first, [player(1)])['reserved'])
+        self.assertTrue(self.reserve(self.first, [player(2)])['error'])
+        self.assertTrue(self.reserve(self.first, [player(1), player(2)])['error'])
+        self.assertEqual(list(self.first.reservations), [player(1)])
+
+    def test_holds_are_capped_per_account(self):
+        self.login('alice', player(1))
+        party = [player(n) for n in range(1, MAX_HOLDS_PER_ACCOUNT + 1)]
+        self.assertFalse(self.matchmake(party)['error'])
+        # One more player than the cap allows, even though the server has plenty of room
+        self.assertTrue(self.matchmake([player(1), player(100)])['error'])
+        self.assertNotIn(player(100), self.first.reservations)
+        self.assertNotIn(player(100), self.second.reservations)
+
+        # Holding the same players again moves their holds instead of counting twice
+        self.assertTrue(self.reserve(self.second, [player(1)])['reserved'])
+        held = [p for server in (self.first, self.second) for p in server.reservations]
+        self.assertEqual(sorted(held), sorted(party))
+
+        # Another account has its own allowance
+        self.login('bob', player(200))
+        self.assertTrue(self.reserve(self.first, [player(200)])['reserved'])
+
+    def test_group_join_holds_only_the_leader(self):
+        self.login('alice', player(1))
+        # The leader has to be in the group it asks for
+        self.assertTrue(self.group_join([player(2), player(3)], self.first)['error'])
+        self.assertEqual(self.first.reservations, {})
+
+        party = [player(n) for n in range(1, 17)]
+        self.assertFalse(self.group_join(party, self.first)['error'])
+        self.assertEqual(list(self.first.reservations), [player(1)])
+        # Each member holds their own slot when they join
+        self.login('bob', player(2))
+        self.assertTrue(self.reserve(self.first, [player(2)])['reserved'])
+        self.assertEqual(sorted(self.first.reservations), [player(1), player(2)])
+
+    def test_group_join_needs_room_for_everyone(self):
+        self.first.maxplayers = '3'
+        self.login('alice', player(1))
+        self.assertTrue(self.group_join([player(1), player(2), player(3), player(4)], self.first)['error'])
+        self.assertEqual(self.first.reservations, {})
+        self.assertFalse(self.group_join([player(1), player(2), player(3)], self.first)['error'])
+
+    def test_holds_are_capped_per_ip(self):
+        # Throwaway accounts from one address share its allowance
+        for n in range(1, MAX_HOLDS_PER_IP + 1):
+            self.login('account%d' % n, player(n))
+            self.assertTrue(self.reserve(self.first, [player(n)])['reserved'])
+        self.login('one too many', player(1000))
+        self.assertTrue(self.reserve(self.first, [player(1000)])['error'])
+        # Extending a hold already counted is fine
+        self.login('account1', player(1))
+        self.assertTrue(self.reserve(self.first, [player(1)])['reserved'])
+        # Another address has its own
+        cherrypy.request.remote.ip = '127.0.0.2'
+        self.login('one too many', player(1000))
+        self.assertTrue(self.reserve(self.first, [player(1000)])['reserved'])
+
+    def test_live_hold_of_another_account_is_kept(self):
+        self.login('alice', player(1))
+        self.assertTrue(self.reserve(self.first, [player(1)])['reserved'])
+        # Another account claiming the same player gets the slot that is already held, it doesn't take the hold over
+        self.login('mallory', player(1))
+        self.assertTrue(self.reserve(self.first, [player(1)])['reserved'])
+        self.assertEqual(self.first.reservations[player(1)].account, 'alice')
+        with self.masterserver.servers_lock:
+            self.assertEqual(self.masterserver.account_holds('alice', time.time()), {player(1) : self.first.id})
+            self.assertEqual(self.masterserver.account_holds('mallory', time.time()), {})
+
+    def test_login_binds_the_player_when_the_account_is_made(self):
+        first = json.loads(self.masterserver.login('', None, player(1)))
+        self.assertFalse(first['error'])
+        self.assertEqual(self.masterserver.signer.verify(first['token'])[:2], (first['id'], player(1)))
+        # A refresh keeps the account and its player
+        refreshed = json.loads(self.masterserver.login('', first['token'], player(1)))
+        self.assertEqual(self.masterserver.signer.verify(refreshed['token'])[:2], (first['id'], player(1)))
+        refreshed = json.loads(self.masterserver.login('', first['token']))
+        self.assertEqual(self.masterserver.signer.verify(refreshed['token'])[:2], (first['id'], player(1)))
+        # but can't switch it to someone else's
+        self.assertTrue(json.loads(self.masterserver.login('', first['token'], player(2)))['error'])
+
+    def test_joined_players_free_the_account_holds(self):
+        self.login('alice', player(1))
+        party = [player(n) for n in range(1, MAX_HOLDS_PER_ACCOUNT + 1)]
+        server = self.masterserver.servers[self.matchmake(party)['server']['id']]
+        self.assertTrue(self.matchmake([player(1), player(100)])['error'])
+        self.masterserver.set_server_players(server, ','.join(party[1:]))
+        self.assertFalse(self.matchmake([player(1), player(100)])['error'])
+
+
+if __name__ == '__main__':
+    unittest.main()